@@ -0,0 +1,405 @@
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_init.h>
+#include <SDL3/SDL_main.h>
+#include <SDL3/SDL_hints.h>
+#include <SDL3/SDL_timer.h>
+#include <SDL3/SDL_render.h>
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_filesystem.h>
+
+#include "core.h"
+#include "memstats.h"
+#include "netplay.h"
+#include "ramsearch.h"
+#include "stub_core.h"
+
+#define BENCH_LOG SDL_LOG_CATEGORY_CUSTOM
+#define BENCH_SAVE "bench_save.bin"
+#define BENCH_VARS 64
+#define BENCH_ROLLBACK_BUDGET_NS (16 * SDL_NS_PER_MS)
+
+static struct {
+    SDL_Surface *surface;
+    SDL_Renderer *renderer;
+    int iterations;
+    bool failed;
+    char keys[BENCH_VARS][32];
+} bench;
+
+static bool BenchInitCore(StubCoreOptions options)
+{
+    StubCore_Configure(options);
+    if (!Core_Init(bench.renderer, (CoreOptions){ .data = ".", .saves = "." })
+        || !Core_LoadGame("stub", 0))
+    {
+        SDL_LogError(BENCH_LOG, "failed to initialize stub core");
+        bench.failed = true;
+        return false;
+    }
+    return true;
+}
+
+static void BenchReport(const char *name, Uint64 start, int count, double bytes)
+{
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    double ns = seconds * 1e9 / count;
+    if (bytes > 0)
+    {
+        SDL_LogInfo(BENCH_LOG, "%-40s %12.1f ns/op %10.1f MB/s", name, ns, bytes * count / seconds / 1e6);
+    }
+    else
+    {
+        SDL_LogInfo(BENCH_LOG, "%-40s %12.1f ns/op", name, ns);
+    }
+}
+
+// Whole frames are timed, so these rows include the stub's retro_run() and SDL_FlushAudioStream() too.
+static void BenchVideo(unsigned width, unsigned height, enum retro_pixel_format format)
+{
+    StubCoreOptions options = { .width = width, .height = height, .format = format };
+    if (!BenchInitCore(options))
+    {
+        return;
+    }
+
+    char name[64];
+    SDL_snprintf(
+        name,
+        sizeof(name),
+        "Core_StepFrame video %ux%u %s",
+        width,
+        height,
+        format == RETRO_PIXEL_FORMAT_XRGB8888 ? "XRGB8888" : "RGB565"
+    );
+
+    int bpp = format == RETRO_PIXEL_FORMAT_XRGB8888 ? 4 : 2;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < bench.iterations; i++)
+    {
+        Core_StepFrame();
+    }
+    BenchReport(name, start, bench.iterations, (double)width * height * bpp);
+}
+
+static void BenchAudio(unsigned batch)
+{
+    StubCoreOptions options = {
+        .format = RETRO_PIXEL_FORMAT_RGB565,
+        .audio_frames = 735,
+        .audio_batch = batch,
+    };
+    if (!BenchInitCore(options))
+    {
+        return;
+    }
+
+    char name[64];
+    if (batch)
+    {
+        SDL_snprintf(name, sizeof(name), "Core_StepFrame audio 735 frames / %u", batch);
+    }
+    else
+    {
+        SDL_snprintf(name, sizeof(name), "Core_StepFrame audio 735 samples");
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < bench.iterations; i++)
+    {
+        Core_StepFrame();
+    }
+    BenchReport(name, start, bench.iterations, 735 * 2 * sizeof(int16_t));
+}
+
+static void BenchSaveGame(size_t size)
+{
+    StubCoreOptions options = { .format = RETRO_PIXEL_FORMAT_RGB565, .state_size = size };
+    if (!BenchInitCore(options))
+    {
+        return;
+    }
+
+    char name[64];
+    SDL_snprintf(name, sizeof(name), "Core_SaveGame %zu KB", size / 1024);
+
+    int count = SDL_max(bench.iterations / 20, 1);
+    size_t live_bytes = Memory_GetStats(MEMORY_SAVE_STATES).live_bytes;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; i++)
+    {
+        Core_SaveGame(BENCH_SAVE);
+    }
+    BenchReport(name, start, count, (double)size);
+    SDL_RemovePath(BENCH_SAVE);
+
+    if (Memory_GetStats(MEMORY_SAVE_STATES).live_bytes != live_bytes)
+    {
+        SDL_LogError(BENCH_LOG, "Core_SaveGame() leaked %zu B", Memory_GetStats(MEMORY_SAVE_STATES).live_bytes - live_bytes);
+        bench.failed = true;
+    }
+}
+
+static void BenchVars()
+{
+    StubCoreOptions options = { .format = RETRO_PIXEL_FORMAT_RGB565 };
+    if (!BenchInitCore(options))
+    {
+        return;
+    }
+
+    // The core keeps key pointers, so keys must outlive it just like libretro's static tables.
+    for (int i = 0; i < BENCH_VARS; i++)
+    {
+        SDL_snprintf(bench.keys[i], sizeof(bench.keys[i]), "bench_option_%d", i);
+        Core_SetVar(bench.keys[i], "disabled");
+    }
+
+    int count = bench.iterations * 100;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; i++)
+    {
+        Core_SetVar(bench.keys[i % BENCH_VARS], (i & 1) ? "enabled" : "disabled");
+    }
+    BenchReport("Core_SetVar", start, count, 0);
+
+    start = SDL_GetPerformanceCounter();
+    size_t found = 0;
+    for (int i = 0; i < count; i++)
+    {
+        found += Core_GetVar(bench.keys[i % BENCH_VARS]) != 0;
+    }
+    BenchReport("Core_GetVar", start, count, 0);
+
+    if (found != (size_t)count || !Core_GetVar("stub_renderer"))
+    {
+        SDL_LogError(BENCH_LOG, "Core_GetVar() lost variables");
+        bench.failed = true;
+    }
+}
+
+static void BenchFrameAllocations()
+{
+    StubCoreOptions options = {
+        .width = 640,
+        .height = 480,
+        .format = RETRO_PIXEL_FORMAT_XRGB8888,
+        .audio_frames = 735,
+        .audio_batch = 735,
+    };
+    if (!BenchInitCore(options))
+    {
+        return;
+    }
+
+    // Draining the stream after every frame stands in for the device, which plays at the same rate
+    // as the game produces in real play but can't keep up with an unthrottled benchmark.
+    for (int i = 0; i < MEMORY_WARMUP_FRAMES; i++)
+    {
+        Core_StepFrame();
+        Core_ClearAudio();
+    }
+
+    Uint64 allocations = 0;
+    for (int i = 0; i < bench.iterations; i++)
+    {
+        Memory_BeginFrame();
+        Core_StepFrame();
+        allocations += Memory_EndFrame(true);
+        Core_ClearAudio();
+    }
+    SDL_LogInfo(BENCH_LOG, "%-40s %12.1f allocations/frame", "Core_StepFrame", (double)allocations / bench.iterations);
+
+    if (allocations)
+    {
+        SDL_LogError(BENCH_LOG, "Core_StepFrame() allocated %" SDL_PRIu64 " times after warm-up", allocations);
+        bench.failed = true;
+    }
+}
+
+static int BenchCompareTimes(const void *a, const void *b)
+{
+    Uint64 x = *(const Uint64 *)a;
+    Uint64 y = *(const Uint64 *)b;
+    return (x > y) - (x < y);
+}
+
+// Times Netplay_Rollback() on a session with no peer, which stalls once it can't predict any further.
+// The stub's retro_run() is nearly free, so this is the frontend's share of the budget. The budget is
+// checked against the median pass so that a single preemption doesn't fail the run.
+static void BenchRollback(size_t size)
+{
+    StubCoreOptions options = {
+        .width = 640,
+        .height = 480,
+        .format = RETRO_PIXEL_FORMAT_XRGB8888,
+        .audio_frames = 735,
+        .audio_batch = 735,
+        .state_size = size,
+    };
+    if (!BenchInitCore(options))
+    {
+        return;
+    }
+
+    NetplayOptions netplay = { .host = "127.0.0.1" };
+    if (!Netplay_Init(netplay))
+    {
+        SDL_LogError(BENCH_LOG, "failed to start a netplay session");
+        bench.failed = true;
+        return;
+    }
+    for (int frames = 0; frames < NETPLAY_MAX_ROLLBACK;)
+    {
+        if (Netplay_RunFrame())
+        {
+            frames++;
+        }
+        else
+        {
+            SDL_Delay(1);
+        }
+        Core_ClearAudio();
+    }
+
+    char name[64];
+    SDL_snprintf(name, sizeof(name), "Netplay_Rollback %d frames %zu KB", NETPLAY_MAX_ROLLBACK, size / 1024);
+
+    int count = SDL_max(bench.iterations / 20, 1);
+    Uint64 *times = SDL_malloc(count * sizeof(*times));
+    SDL_assert_release(times);
+
+    Uint64 allocations = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; i++)
+    {
+        Uint64 t = SDL_GetTicksNS();
+        Memory_BeginFrame();
+        Netplay_Rollback(NETPLAY_MAX_ROLLBACK);
+        allocations += Memory_EndFrame(true);
+        times[i] = SDL_GetTicksNS() - t;
+        Core_ClearAudio();
+    }
+    BenchReport(name, start, count, (double)size * (NETPLAY_MAX_ROLLBACK + 2));
+    Netplay_Free();
+
+    SDL_qsort(times, count, sizeof(*times), BenchCompareTimes);
+    Uint64 median = times[count / 2];
+    Uint64 worst = times[count - 1];
+    SDL_free(times);
+    SDL_LogInfo(BENCH_LOG, "%-40s %12.2f ms median %8.2f ms worst", name, median / 1e6, worst / 1e6);
+
+    if (allocations)
+    {
+        SDL_LogError(BENCH_LOG, "%s allocated %" SDL_PRIu64 " times", name, allocations);
+        bench.failed = true;
+    }
+    if (median > BENCH_ROLLBACK_BUDGET_NS)
+    {
+        SDL_LogError(
+            BENCH_LOG,
+            "%s took %.2f ms (median), over the %.0f ms budget",
+            name,
+            median / 1e6,
+            BENCH_ROLLBACK_BUDGET_NS / 1e6
+        );
+        bench.failed = true;
+    }
+}
+
+static void BenchRamSearch(RamSearchWidth width, RamSearchFilter filter, const char *name)
+{
+    StubCoreOptions options = { .format = RETRO_PIXEL_FORMAT_RGB565 };
+    if (!BenchInitCore(options))
+    {
+        return;
+    }
+
+    size_t size = 0;
+    Uint8 *ram = Core_GetSystemRam(&size);
+
+    Uint64 elapsed = 0;
+    for (int i = 0; i < bench.iterations; i++)
+    {
+        RamSearch_Begin(ram, size, width);
+        Core_StepFrame();
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        RamSearch_Filter(ram, filter, -4, 4);
+        elapsed += SDL_GetPerformanceCounter() - start;
+    }
+    RamSearch_End();
+
+    // Report against a fake start so that only the filter passes are counted.
+    BenchReport(name, SDL_GetPerformanceCounter() - elapsed, bench.iterations, (double)size);
+}
+
+int main(int argc, char **argv)
+{
+    bench.iterations = 2000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!SDL_strcmp(argv[i], "--quick"))
+        {
+            bench.iterations = 200;
+        }
+        else if (!SDL_strcmp(argv[i], "--iterations") && i + 1 < argc)
+        {
+            bench.iterations = SDL_max(SDL_atoi(argv[++i]), 1);
+        }
+    }
+
+    Memory_Init();
+    Memory_SetFrameGuard(false);
+
+    SDL_SetLogPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN);
+    SDL_SetLogPriority(BENCH_LOG, SDL_LOG_PRIORITY_INFO);
+
+    SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+    if (!SDL_Init(SDL_INIT_AUDIO))
+    {
+        SDL_LogError(BENCH_LOG, "SDL_Init(): %s", SDL_GetError());
+        return 1;
+    }
+
+    bench.surface = SDL_CreateSurface(16, 16, SDL_PIXELFORMAT_XRGB8888);
+    bench.renderer = SDL_CreateSoftwareRenderer(bench.surface);
+    if (!bench.renderer)
+    {
+        SDL_LogError(BENCH_LOG, "SDL_CreateSoftwareRenderer(): %s", SDL_GetError());
+        return 1;
+    }
+
+    SDL_LogInfo(BENCH_LOG, "%d iterations", bench.iterations);
+
+    BenchVideo(320, 240, RETRO_PIXEL_FORMAT_RGB565);
+    BenchVideo(640, 480, RETRO_PIXEL_FORMAT_RGB565);
+    BenchVideo(320, 240, RETRO_PIXEL_FORMAT_XRGB8888);
+    BenchVideo(640, 480, RETRO_PIXEL_FORMAT_XRGB8888);
+    BenchVideo(1024, 512, RETRO_PIXEL_FORMAT_XRGB8888);
+
+    BenchAudio(0);
+    BenchAudio(1);
+    BenchAudio(64);
+    BenchAudio(735);
+
+    BenchSaveGame(256 * 1024);
+    BenchSaveGame(4 * 1024 * 1024);
+
+    BenchVars();
+    BenchFrameAllocations();
+
+    BenchRollback(1024 * 1024);
+    BenchRollback(4 * 1024 * 1024);
+
+    BenchRamSearch(RAMSEARCH_8, RAMSEARCH_CHANGED, "RamSearch_Filter 2 MB 8-bit changed");
+    BenchRamSearch(RAMSEARCH_16, RAMSEARCH_INCREASED, "RamSearch_Filter 2 MB 16-bit increased");
+    BenchRamSearch(RAMSEARCH_32, RAMSEARCH_DELTA, "RamSearch_Filter 2 MB 32-bit delta");
+
+    Core_UnloadGame();
+    Core_Free();
+    SDL_DestroyRenderer(bench.renderer);
+    SDL_DestroySurface(bench.surface);
+    SDL_Quit();
+
+    return bench.failed ? 1 : 0;
+}
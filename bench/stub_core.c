@@ -0,0 +1,251 @@
+#include "stub_core.h"
+
+#include <SDL3/SDL_assert.h>
+
+#define STUB_RAM_SIZE (2 * 1024 * 1024)
+
+static struct {
+    StubCoreOptions options;
+    retro_environment_t env;
+    retro_video_refresh_t video;
+    retro_audio_sample_t audio_sample;
+    retro_audio_sample_batch_t audio_batch;
+    retro_input_poll_t input_poll;
+    retro_input_state_t input_state;
+    Uint8 *frame;
+    size_t pitch;
+    int16_t *audio;
+    Uint8 ram[STUB_RAM_SIZE];
+    Uint64 counter;
+} stub;
+
+void StubCore_Configure(StubCoreOptions options)
+{
+    SDL_free(stub.frame);
+    SDL_free(stub.audio);
+
+    stub.options = options;
+    stub.pitch = options.width * (options.format == RETRO_PIXEL_FORMAT_XRGB8888 ? 4 : 2);
+    stub.frame = SDL_malloc(SDL_max(stub.pitch * options.height, 1));
+    stub.audio = SDL_malloc(SDL_max(options.audio_frames * 2 * sizeof(int16_t), 1));
+    SDL_assert_release(stub.frame && stub.audio);
+
+    for (size_t i = 0; i < stub.pitch * options.height; i++)
+    {
+        stub.frame[i] = (Uint8)(i * 7);
+    }
+    for (unsigned i = 0; i < options.audio_frames * 2; i++)
+    {
+        stub.audio[i] = (int16_t)((i % 200) * 300 - 30000);
+    }
+}
+
+RETRO_API unsigned retro_api_version(void)
+{
+    return RETRO_API_VERSION;
+}
+
+RETRO_API void retro_get_system_info(struct retro_system_info *info)
+{
+    *info = (struct retro_system_info){
+        .library_name = "Stub",
+        .library_version = "1.0",
+        .valid_extensions = "bin",
+        .need_fullpath = true,
+    };
+}
+
+RETRO_API void retro_get_system_av_info(struct retro_system_av_info *info)
+{
+    *info = (struct retro_system_av_info){
+        .geometry = {
+            .base_width = SDL_max(stub.options.width, 1),
+            .base_height = SDL_max(stub.options.height, 1),
+            .max_width = SDL_max(stub.options.width, 1),
+            .max_height = SDL_max(stub.options.height, 1),
+        },
+        .timing = {
+            .fps = 60,
+            .sample_rate = 44100,
+        },
+    };
+}
+
+RETRO_API void retro_set_environment(retro_environment_t cb)
+{
+    stub.env = cb;
+
+    static const struct retro_variable vars[] = {
+        { "stub_renderer", "Renderer; software|hardware" },
+        { "stub_resolution_scale", "Resolution Scale; 1|2|4|8" },
+        { "stub_audio_sync", "Audio Sync; enabled|disabled" },
+        { 0, 0 },
+    };
+    cb(RETRO_ENVIRONMENT_SET_VARIABLES, (void *)vars);
+}
+
+RETRO_API void retro_set_video_refresh(retro_video_refresh_t cb)
+{
+    stub.video = cb;
+}
+
+RETRO_API void retro_set_audio_sample(retro_audio_sample_t cb)
+{
+    stub.audio_sample = cb;
+}
+
+RETRO_API void retro_set_audio_sample_batch(retro_audio_sample_batch_t cb)
+{
+    stub.audio_batch = cb;
+}
+
+RETRO_API void retro_set_input_poll(retro_input_poll_t cb)
+{
+    stub.input_poll = cb;
+}
+
+RETRO_API void retro_set_input_state(retro_input_state_t cb)
+{
+    stub.input_state = cb;
+}
+
+RETRO_API void retro_init(void)
+{
+    retro_reset();
+}
+
+RETRO_API void retro_deinit(void)
+{
+}
+
+RETRO_API void retro_set_controller_port_device(unsigned port, unsigned device)
+{
+}
+
+RETRO_API void retro_reset(void)
+{
+    stub.counter = 0;
+    SDL_memset(stub.ram, 0, sizeof(stub.ram));
+}
+
+RETRO_API void retro_run(void)
+{
+    stub.input_poll();
+    Uint16 buttons = stub.input_state(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_MASK);
+
+    // Deterministic RAM churn so searches and save states have something to look at.
+    Uint32 *words = (Uint32 *)stub.ram;
+    words[stub.counter % (STUB_RAM_SIZE / 4)] += (Uint32)stub.counter ^ buttons;
+    words[0] = (Uint32)stub.counter;
+
+    if (stub.options.width && stub.options.height)
+    {
+        SDL_memset(
+            stub.frame + (stub.counter % stub.options.height) * stub.pitch,
+            (int)stub.counter,
+            stub.pitch
+        );
+        stub.video(stub.frame, stub.options.width, stub.options.height, stub.pitch);
+    }
+    else
+    {
+        stub.video(0, stub.options.width, stub.options.height, stub.pitch);
+    }
+
+    if (!stub.options.audio_batch)
+    {
+        for (unsigned i = 0; i < stub.options.audio_frames; i++)
+        {
+            stub.audio_sample(stub.audio[i * 2], stub.audio[i * 2 + 1]);
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < stub.options.audio_frames; i += stub.options.audio_batch)
+        {
+            size_t frames = SDL_min(stub.options.audio_batch, stub.options.audio_frames - i);
+            stub.audio_batch(stub.audio + i * 2, frames);
+        }
+    }
+
+    stub.counter++;
+}
+
+RETRO_API size_t retro_serialize_size(void)
+{
+    return SDL_max(stub.options.state_size, sizeof(stub.counter));
+}
+
+RETRO_API bool retro_serialize(void *data, size_t size)
+{
+    if (size < retro_serialize_size())
+    {
+        return false;
+    }
+
+    Uint8 *out = data;
+    SDL_memcpy(out, &stub.counter, sizeof(stub.counter));
+    size_t offset = sizeof(stub.counter);
+    while (offset < size)
+    {
+        size_t chunk = SDL_min(size - offset, sizeof(stub.ram));
+        SDL_memcpy(out + offset, stub.ram, chunk);
+        offset += chunk;
+    }
+    return true;
+}
+
+RETRO_API bool retro_unserialize(const void *data, size_t size)
+{
+    if (size < retro_serialize_size())
+    {
+        return false;
+    }
+
+    const Uint8 *in = data;
+    SDL_memcpy(&stub.counter, in, sizeof(stub.counter));
+    SDL_memcpy(stub.ram, in + sizeof(stub.counter), SDL_min(size - sizeof(stub.counter), sizeof(stub.ram)));
+    return true;
+}
+
+RETRO_API void retro_cheat_reset(void)
+{
+}
+
+RETRO_API void retro_cheat_set(unsigned index, bool enabled, const char *code)
+{
+}
+
+RETRO_API bool retro_load_game(const struct retro_game_info *game)
+{
+    enum retro_pixel_format format = stub.options.format;
+    return stub.env(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &format);
+}
+
+RETRO_API bool retro_load_game_special(
+    unsigned game_type,
+    const struct retro_game_info *info,
+    size_t num_info
+)
+{
+    return false;
+}
+
+RETRO_API void retro_unload_game(void)
+{
+}
+
+RETRO_API unsigned retro_get_region(void)
+{
+    return RETRO_REGION_NTSC;
+}
+
+RETRO_API void *retro_get_memory_data(unsigned id)
+{
+    return (id == RETRO_MEMORY_SYSTEM_RAM) ? (stub.ram) : (0);
+}
+
+RETRO_API size_t retro_get_memory_size(unsigned id)
+{
+    return (id == RETRO_MEMORY_SYSTEM_RAM) ? (sizeof(stub.ram)) : (0);
+}
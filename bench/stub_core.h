@@ -0,0 +1,16 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+
+#include <libretro.h>
+
+typedef struct {
+    unsigned width;
+    unsigned height;
+    enum retro_pixel_format format;
+    unsigned audio_frames;
+    unsigned audio_batch;
+    size_t state_size;
+} StubCoreOptions;
+
+void StubCore_Configure(StubCoreOptions options);
@@ -0,0 +1,95 @@
+# Builds a plain Release, an LTO Release and an LTO+PGO frontend, trains the PGO build on a headless
+# save state replay and reports the FPS of each step against the previous one and the plain build.
+#
+#   cmake -DSAVE=saves/<serial>/autosave.bin [-DCOMPILER=gcc|clang] [-DFRAMES=3600] -P cmake/pgo.cmake
+
+cmake_minimum_required(VERSION 3.21.0)
+
+get_filename_component(SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+
+if(NOT SAVE)
+    message(FATAL_ERROR "Pass the save state to replay with -DSAVE=<path>")
+endif()
+get_filename_component(SAVE "${SAVE}" ABSOLUTE BASE_DIR "${SOURCE_DIR}")
+if(NOT COMPILER)
+    set(COMPILER "gcc")
+endif()
+if(NOT FRAMES)
+    set(FRAMES 3600)
+endif()
+
+set(PLAIN_DIR "${SOURCE_DIR}/out/.cmake/linux-${COMPILER}-plain")
+set(RELEASE_DIR "${SOURCE_DIR}/out/.cmake/linux-${COMPILER}-release")
+set(PGO_DIR "${SOURCE_DIR}/out/.cmake/linux-${COMPILER}-pgo")
+
+function(run)
+    execute_process(COMMAND ${ARGN} WORKING_DIRECTORY "${SOURCE_DIR}" RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Command failed (${result}): ${ARGN}")
+    endif()
+endfunction()
+
+function(build preset)
+    message(STATUS "Building ${preset}")
+    run("${CMAKE_COMMAND}" --preset ${preset})
+    run("${CMAKE_COMMAND}" --build --preset ${preset})
+endfunction()
+
+function(replay dir out_fps)
+    execute_process(
+        COMMAND "${dir}/Emulator" --replay "${SAVE}" --frames ${FRAMES}
+        WORKING_DIRECTORY "${SOURCE_DIR}"
+        RESULT_VARIABLE result
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE output
+    )
+    string(REGEX MATCH "Replay: [0-9]+ frames in [0-9.]+s \\(([0-9.]+) fps\\)" match "${output}")
+    if(NOT result EQUAL 0 OR NOT match)
+        message(FATAL_ERROR "Replay in ${dir} failed (${result}):\n${output}")
+    endif()
+    set(${out_fps} ${CMAKE_MATCH_1} PARENT_SCOPE)
+endfunction()
+
+# Replays print FPS with one decimal, so dropping the point gives tenths of a frame.
+function(delta base value out)
+    string(REPLACE "." "" base_tenths "${base}")
+    string(REPLACE "." "" value_tenths "${value}")
+    math(EXPR permille "(${value_tenths} - ${base_tenths}) * 1000 / ${base_tenths}")
+    set(sign "+")
+    if(permille LESS 0)
+        set(sign "-")
+        math(EXPR permille "-(${permille})")
+    endif()
+    math(EXPR whole "${permille} / 10")
+    math(EXPR fraction "${permille} % 10")
+    set(${out} "${sign}${whole}.${fraction}%" PARENT_SCOPE)
+endfunction()
+
+build(linux-${COMPILER}-plain)
+build(linux-${COMPILER}-release)
+
+file(REMOVE_RECURSE "${PGO_DIR}/pgo")
+build(linux-${COMPILER}-pgo-generate)
+message(STATUS "Training on ${SAVE} (${FRAMES} frames)")
+replay("${PGO_DIR}" training_fps)
+
+if(COMPILER STREQUAL "clang")
+    find_program(LLVM_PROFDATA NAMES llvm-profdata)
+    if(NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "llvm-profdata is required to merge Clang profiles")
+    endif()
+    file(GLOB profiles "${PGO_DIR}/pgo/*.profraw")
+    run("${LLVM_PROFDATA}" merge "-output=${PGO_DIR}/pgo/default.profdata" ${profiles})
+endif()
+
+build(linux-${COMPILER}-pgo-use)
+
+replay("${PLAIN_DIR}" plain_fps)
+replay("${RELEASE_DIR}" lto_fps)
+replay("${PGO_DIR}" pgo_fps)
+delta(${plain_fps} ${lto_fps} lto_delta)
+delta(${lto_fps} ${pgo_fps} pgo_delta)
+delta(${plain_fps} ${pgo_fps} total_delta)
+message(STATUS "Release: ${plain_fps} fps")
+message(STATUS "LTO:     ${lto_fps} fps (${lto_delta} over Release)")
+message(STATUS "LTO+PGO: ${pgo_fps} fps (${pgo_delta} over LTO, ${total_delta} over Release)")
@@ -1,4 +1,6 @@
 #include "core.h"
+#include "trace.h"
+#include "memstats.h"
 
 #include <SDL3/SDL_log.h>
 #include <SDL3/SDL_timer.h>
@@ -27,10 +29,12 @@ static struct {
     SDL_FRect frame_rect;
     Uint64 last_frame_tick;
     struct {
-        bool joypad[16];
+        Uint16 joypad[CORE_MAX_PORTS];
     } input;
     bool cheats;
+    CoreMouseLook mouse_look;
     bool vars_dirty;
+    bool replaying;
 } core;
 
 static RETRO_CALLCONV bool CoreEnvCallback(unsigned cmd, void *data);
@@ -59,7 +63,9 @@ bool Core_Init(SDL_Renderer *renderer, CoreOptions options)
 
     SDL_Log("Initializing Core ...");
 
+    MemoryTag tag = Memory_SetTag(MEMORY_CORE_VARS);
     core.vars = kh_init(dict);
+    Memory_SetTag(tag);
     core.renderer = renderer;
     core.options = options;
 
@@ -81,6 +87,7 @@ bool Core_Init(SDL_Renderer *renderer, CoreOptions options)
         core.avinfo.timing.fps
     );
 
+    tag = Memory_SetTag(MEMORY_AUDIO);
     core.audio = SDL_OpenAudioDeviceStream(
         SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK,
         &(SDL_AudioSpec){
@@ -91,6 +98,7 @@ bool Core_Init(SDL_Renderer *renderer, CoreOptions options)
         0,
         0
     );
+    Memory_SetTag(tag);
     if (!core.audio)
     {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_OpenAudioDeviceStream(): %s", SDL_GetError());
@@ -113,14 +121,42 @@ bool Core_Init(SDL_Renderer *renderer, CoreOptions options)
 void Core_Free()
 {
     retro_deinit();
+    if (core.vars)
+    {
+        for (khiter_t it = kh_begin(core.vars); it != kh_end(core.vars); it++)
+        {
+            if (kh_exist(core.vars, it)) SDL_free(kh_value(core.vars, it));
+        }
+    }
     kh_destroy(dict, core.vars);
+    SDL_DestroyTexture(core.frame);
+    SDL_DestroyAudioStream(core.audio);
     SDL_memset(&core, 0, sizeof(core));
 }
 
 void Core_SetInput(CoreInput id, bool state)
 {
     SDL_assert(id < 16);
-    core.input.joypad[id] = state;
+    if (state)
+    {
+        core.input.joypad[0] |= 1 << id;
+    }
+    else
+    {
+        core.input.joypad[0] &= ~(1 << id);
+    }
+}
+
+Uint16 Core_GetInputState(unsigned port)
+{
+    SDL_assert(port < CORE_MAX_PORTS);
+    return core.input.joypad[port];
+}
+
+void Core_SetInputState(unsigned port, Uint16 buttons)
+{
+    SDL_assert(port < CORE_MAX_PORTS);
+    core.input.joypad[port] = buttons;
 }
 
 bool Core_LoadGame(const char *path, const char *save)
@@ -138,7 +174,10 @@ bool Core_LoadGame(const char *path, const char *save)
     size_t ss = 0;
     if (save)
     {
-        if (!(s = SDL_LoadFile(save, &ss)))
+        MemoryTag tag = Memory_SetTag(MEMORY_SAVE_STATES);
+        s = SDL_LoadFile(save, &ss);
+        Memory_SetTag(tag);
+        if (!s)
         {
             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to read save file");
         }
@@ -165,23 +204,42 @@ void Core_UnloadGame()
 
 void Core_SaveGame(const char *save)
 {
+    TRACE_BEGIN(Core_SaveGame);
     size_t size = retro_serialize_size();
+    MemoryTag tag = Memory_SetTag(MEMORY_SAVE_STATES);
     void *data = SDL_malloc(size);
+    Memory_SetTag(tag);
 
     if (!retro_serialize(data, size))
     {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "retro_serialize() failed");
-        SDL_free(data);
-        return;
     }
     else if (!SDL_SaveFile(save, data, size))
     {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to write save state");
-        SDL_free(data);
-        return;
     }
+    else
+    {
+        SDL_Log("Saved state to \"%s\"", save);
+    }
+
+    SDL_free(data);
+    TRACE_END(Core_SaveGame);
+}
 
-    SDL_Log("Saved state to \"%s\"", save);
+size_t Core_GetStateSize()
+{
+    return retro_serialize_size();
+}
+
+bool Core_SerializeState(void *data, size_t size)
+{
+    return retro_serialize(data, size);
+}
+
+bool Core_UnserializeState(const void *data, size_t size)
+{
+    return retro_unserialize(data, size);
 }
 
 void Core_SetCheatsEnabled(bool enabled)
@@ -195,31 +253,73 @@ bool Core_AreCheatsEnabled()
     return core.cheats;
 }
 
+void Core_SetMouseLook(CoreMouseLook mouse_look)
+{
+    core.mouse_look = mouse_look;
+    SDL_Log("Mouse look: yaw=0x%X pitch=0x%X", mouse_look.yaw, mouse_look.pitch);
+}
+
 bool Core_RunFrame()
 {
-    if (core.cheats)
+    TRACE_BEGIN(Core_RunFrame);
+    Memory_BeginFrame();
+    if (core.cheats && core.mouse_look.yaw && core.mouse_look.pitch)
     {
         unsigned char *mem = retro_get_memory_data(RETRO_MEMORY_SYSTEM_RAM);
         SDL_assert(mem);
         size_t size = retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM);
-        SDL_assert(size);
+        SDL_assert(core.mouse_look.yaw + 2 <= size && core.mouse_look.pitch + 2 <= size);
 
         float x, y;
         SDL_GetRelativeMouseState(&x, &y);
-        *((uint16_t*)&mem[0x1A26CA]) -= x * 0.5;
-        *((uint16_t*)&mem[0x411C0]) += y * 0.5;
+        *((uint16_t*)&mem[core.mouse_look.yaw]) -= x * 0.5;
+        *((uint16_t*)&mem[core.mouse_look.pitch]) += y * 0.5;
     }
 
+    bool ran = false;
     Uint64 tick = SDL_GetTicks();
-    if ((tick - core.last_frame_tick) / 1000.0 < 1 / core.avinfo.timing.fps)
+    if ((tick - core.last_frame_tick) / 1000.0 >= 1 / core.avinfo.timing.fps)
     {
-        return false;
+        Core_StepFrame();
+        core.last_frame_tick = tick;
+        ran = true;
     }
 
+    Memory_EndFrame(ran);
+    TRACE_END(Core_RunFrame);
+    return ran;
+}
+
+void Core_StepFrame()
+{
+    TRACE_BEGIN(retro_run);
     retro_run();
-    SDL_FlushAudioStream(core.audio);
-    core.last_frame_tick = tick;
-    return true;
+    TRACE_END(retro_run);
+    if (!core.replaying)
+    {
+        SDL_FlushAudioStream(core.audio);
+    }
+}
+
+void Core_SetReplaying(bool replaying)
+{
+    core.replaying = replaying;
+}
+
+void Core_ClearAudio()
+{
+    SDL_ClearAudioStream(core.audio);
+}
+
+double Core_GetFrameRate()
+{
+    return core.avinfo.timing.fps;
+}
+
+Uint8 *Core_GetSystemRam(size_t *size)
+{
+    *size = retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM);
+    return retro_get_memory_data(RETRO_MEMORY_SYSTEM_RAM);
 }
 
 SDL_Texture *Core_GetFramebuffer()
@@ -234,6 +334,7 @@ SDL_FRect Core_GetFramebufferRect()
 
 void Core_SetVar(const char *key, const char *value)
 {
+    MemoryTag tag = Memory_SetTag(MEMORY_CORE_VARS);
     khiter_t it = kh_get(dict, core.vars, key);
     if (it == kh_end(core.vars))
     {
@@ -245,6 +346,7 @@ void Core_SetVar(const char *key, const char *value)
         SDL_free(kh_value(core.vars, it));
     }
     kh_value(core.vars, it) = SDL_strdup(value);
+    Memory_SetTag(tag);
     core.vars_dirty = true;
     // SDL_Log("\"%s\" = \"%s\"", key, kh_value(core.vars, it));
 }
@@ -252,7 +354,7 @@ void Core_SetVar(const char *key, const char *value)
 const char *Core_GetVar(const char *key)
 {
     khiter_t it = kh_get(dict, core.vars, key);
-    return (it == kh_end(core.vars)) ? (kh_value(core.vars, it)) : (0);
+    return (it != kh_end(core.vars)) ? (kh_value(core.vars, it)) : (0);
 }
 
 static RETRO_CALLCONV bool CoreEnvCallback(unsigned cmd, void *data)
@@ -396,6 +498,7 @@ static RETRO_CALLCONV bool CoreEnvCallback(unsigned cmd, void *data)
                 [RETRO_PIXEL_FORMAT_XRGB8888] = SDL_PIXELFORMAT_XRGB8888,
                 [RETRO_PIXEL_FORMAT_RGB565] = SDL_PIXELFORMAT_RGB565,
             };
+            MemoryTag tag = Memory_SetTag(MEMORY_TEXTURES);
             core.frame = SDL_CreateTexture(
                 core.renderer,
                 formats[*f],
@@ -403,6 +506,7 @@ static RETRO_CALLCONV bool CoreEnvCallback(unsigned cmd, void *data)
                 core.avinfo.geometry.max_width,
                 core.avinfo.geometry.max_height
             );
+            Memory_SetTag(tag);
             SDL_assert(core.frame);
             SDL_Log("Created framebuffer (%d)", *f);
             return true;
@@ -460,26 +564,44 @@ RETRO_CALLCONV void CoreVideoCallback(
     size_t pitch
 )
 {
-    if (!data)
+    if (!data || core.replaying)
     {
         return;
     }
 
+    TRACE_BEGIN(CoreVideoCallback);
     core.frame_rect.w = width;
     core.frame_rect.h = height;
     SDL_Rect r = { 0, 0, core.frame_rect.w, core.frame_rect.h };
     SDL_UpdateTexture(core.frame, &r, data, (int)pitch);
+    TRACE_END(CoreVideoCallback);
 }
 
 RETRO_CALLCONV void CoreAudioSampleCallback(int16_t left, int16_t right)
 {
+    if (core.replaying)
+    {
+        return;
+    }
+
     int16_t buf[] = { left, right };
+    MemoryTag tag = Memory_SetTag(MEMORY_AUDIO);
     SDL_PutAudioStreamData(core.audio, buf, sizeof(buf));
+    Memory_SetTag(tag);
 }
 
 RETRO_CALLCONV size_t CoreAudioCallback(const int16_t *data, size_t frames)
 {
+    if (core.replaying)
+    {
+        return frames;
+    }
+
+    TRACE_BEGIN(CoreAudioCallback);
+    MemoryTag tag = Memory_SetTag(MEMORY_AUDIO);
     SDL_PutAudioStreamData(core.audio, data, (int)frames * sizeof(int16_t) * 2);
+    Memory_SetTag(tag);
+    TRACE_END(CoreAudioCallback);
     return frames;
 }
 
@@ -494,9 +616,13 @@ RETRO_CALLCONV int16_t CoreInputStateCallback(
     unsigned id
 )
 {
-    if (port != 0) return 0;
+    if (port >= CORE_MAX_PORTS) return 0;
 
-    if (device == RETRO_DEVICE_JOYPAD) return core.input.joypad[id];
+    if (device == RETRO_DEVICE_JOYPAD)
+    {
+        if (id == RETRO_DEVICE_ID_JOYPAD_MASK) return core.input.joypad[port];
+        return (core.input.joypad[port] >> id) & 1;
+    }
 
     SDL_Log("Unknown input device %lu", device);
     return 0;
@@ -27,20 +27,40 @@ typedef enum {
     CORE_JOYPAD_R3 = 15,
 } CoreInput;
 
+#define CORE_MAX_PORTS 2
+
+// System RAM offsets of the 16-bit camera angles that mouse look writes to, zero if unsupported.
+typedef struct {
+    Uint32 yaw;
+    Uint32 pitch;
+} CoreMouseLook;
+
 bool Core_Init(SDL_Renderer *renderer, CoreOptions options);
 void Core_Free();
 
 void Core_SetInput(CoreInput id, bool state);
+Uint16 Core_GetInputState(unsigned port);
+void Core_SetInputState(unsigned port, Uint16 buttons);
 
 bool Core_LoadGame(const char *path, const char *save);
 void Core_UnloadGame();
 
 void Core_SaveGame(const char *save);
 
+size_t Core_GetStateSize();
+bool Core_SerializeState(void *data, size_t size);
+bool Core_UnserializeState(const void *data, size_t size);
+
 void Core_SetCheatsEnabled(bool enabled);
 bool Core_AreCheatsEnabled();
+void Core_SetMouseLook(CoreMouseLook mouse_look);
 
 bool Core_RunFrame();
+void Core_StepFrame();
+void Core_SetReplaying(bool replaying);
+void Core_ClearAudio();
+double Core_GetFrameRate();
+Uint8 *Core_GetSystemRam(size_t *size);
 SDL_Texture *Core_GetFramebuffer();
 SDL_FRect Core_GetFramebufferRect();
 
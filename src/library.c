@@ -0,0 +1,688 @@
+#include "library.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+#include <SDL3/SDL_assert.h>
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_filesystem.h>
+
+#define kcalloc SDL_calloc
+#define kmalloc SDL_malloc
+#define krealloc SDL_realloc
+#define kfree SDL_free
+#include <klib/khash.h>
+
+#ifdef EMULATOR_LIBCHDR
+#include <libchdr/chd.h>
+#endif
+
+#define LIBRARY_INDEX_HEADER "ACLIB 1"
+#define LIBRARY_CHD_MAGIC "MComprHD"
+#define LIBRARY_CHD_CHT2 0x43485432 // "CHT2"
+#define LIBRARY_CHD_CHTR 0x43485452 // "CHTR"
+#define LIBRARY_SECTOR 2048
+#define LIBRARY_LEGACY_ROM "rom.chd"
+
+KHASH_MAP_INIT_STR(games, int);
+
+// Mouse look writes into RAM, so it is only enabled for known serials. A data/rom.chd that can't be
+// identified is assumed to be Armored Core (USA), which is what the frontend used to require.
+static const struct {
+    const char *serial;
+    CoreMouseLook mouse_look;
+} library_patches[] = {
+    { "SCUS-94182", { 0x1A26CA, 0x411C0 } }, // Armored Core (USA)
+};
+
+typedef struct {
+    SDL_IOStream *io;
+    Uint32 sector_size;
+    Uint32 data_offset;
+#ifdef EMULATOR_LIBCHDR
+    chd_file *chd;
+    Uint8 *hunk;
+    Uint32 hunk_bytes;
+    Uint32 unit_bytes;
+    Uint32 hunk_index;
+#endif
+} LibraryDisc;
+
+static struct {
+    LibraryOptions options;
+    LibraryGame *games;
+    int count;
+    int capacity;
+} library;
+
+static LibraryGame *LibraryAdd();
+static bool LibraryLoadIndex(const char *path, LibraryGame **games, int *count);
+static bool LibrarySaveIndex();
+static bool LibraryScan(LibraryGame *game);
+static bool LibraryScanChd(LibraryGame *game, LibraryDisc *disc);
+static bool LibraryScanCue(LibraryGame *game, LibraryDisc *disc);
+static bool LibraryReadSector(LibraryDisc *disc, Uint32 lba, Uint8 *out);
+static void LibraryReadSerial(LibraryDisc *disc, char *serial, size_t size);
+static void LibraryMakeKey(LibraryGame *game);
+
+typedef struct {
+    LibraryGame *cached;
+    int cached_count;
+    khash_t(games) *paths;
+    int scanned;
+} LibraryEnumeration;
+
+static SDL_EnumerationResult SDLCALL LibraryEnumerateCallback(void *userdata, const char *dirname, const char *fname)
+{
+    LibraryEnumeration *e = userdata;
+
+    const char *ext = SDL_strrchr(fname, '.');
+    if (!ext || (SDL_strcasecmp(ext, ".chd") != 0 && SDL_strcasecmp(ext, ".cue") != 0))
+    {
+        return SDL_ENUM_CONTINUE;
+    }
+
+    // Windows hands out backslashes, the index and every lookup below only deal with forward slashes.
+    char path[256];
+    SDL_snprintf(path, sizeof(path), "%s%s", dirname, fname);
+    for (char *c = path; *c; c++)
+    {
+        if (*c == '\\')
+        {
+            *c = '/';
+        }
+    }
+
+    SDL_PathInfo info;
+    if (!SDL_GetPathInfo(path, &info) || info.type != SDL_PATHTYPE_FILE)
+    {
+        return SDL_ENUM_CONTINUE;
+    }
+
+    LibraryGame *game = LibraryAdd();
+    khiter_t it = kh_get(games, e->paths, path);
+    if (it != kh_end(e->paths))
+    {
+        const LibraryGame *cached = &e->cached[kh_value(e->paths, it)];
+        if (cached->size == info.size && cached->mtime == info.modify_time)
+        {
+            *game = *cached;
+            return SDL_ENUM_CONTINUE;
+        }
+    }
+
+    SDL_strlcpy(game->path, path, sizeof(game->path));
+    SDL_strlcpy(game->format, ext + 1, sizeof(game->format));
+    game->size = info.size;
+    game->mtime = info.modify_time;
+    if (!LibraryScan(game))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to read \"%s\"", path);
+    }
+    LibraryMakeKey(game);
+    e->scanned++;
+    return SDL_ENUM_CONTINUE;
+}
+
+static int LibraryCompareGames(const void *a, const void *b)
+{
+    return SDL_strcmp(((const LibraryGame *)a)->path, ((const LibraryGame *)b)->path);
+}
+
+bool Library_Init(LibraryOptions options)
+{
+    Library_Free();
+
+    SDL_Log("Initializing Library ...");
+    library.options = options;
+
+    Uint64 start = SDL_GetTicksNS();
+    LibraryEnumeration e = { .paths = kh_init(games) };
+    LibraryLoadIndex(options.index, &e.cached, &e.cached_count);
+    for (int i = 0; i < e.cached_count; i++)
+    {
+        int ret = 0;
+        khiter_t it = kh_put(games, e.paths, e.cached[i].path, &ret);
+        kh_value(e.paths, it) = i;
+    }
+
+    bool ok = SDL_EnumerateDirectory(options.directory, LibraryEnumerateCallback, &e);
+    if (!ok)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to list \"%s\": %s", options.directory, SDL_GetError());
+    }
+
+    // Removed images also invalidate the index.
+    bool dirty = e.scanned || library.count != e.cached_count;
+    kh_destroy(games, e.paths);
+    SDL_free(e.cached);
+
+    SDL_qsort(library.games, library.count, sizeof(*library.games), LibraryCompareGames);
+    if (dirty)
+    {
+        LibrarySaveIndex();
+    }
+
+    SDL_Log(
+        "Library: %d games (%d scanned) in %.1fms",
+        library.count,
+        e.scanned,
+        (SDL_GetTicksNS() - start) / 1e6
+    );
+    return ok;
+}
+
+void Library_Free()
+{
+    SDL_free(library.games);
+    SDL_memset(&library, 0, sizeof(library));
+}
+
+int Library_GetCount()
+{
+    return library.count;
+}
+
+const LibraryGame *Library_GetGame(int i)
+{
+    SDL_assert(i >= 0 && i < library.count);
+    return &library.games[i];
+}
+
+const LibraryGame *Library_FindGame(const char *name)
+{
+    for (int i = 0; i < library.count; i++)
+    {
+        const LibraryGame *game = &library.games[i];
+        const char *fname = SDL_strrchr(game->path, '/');
+        fname = fname ? fname + 1 : game->path;
+        if (!SDL_strcmp(game->path, name)
+            || !SDL_strcmp(fname, name)
+            || (game->serial[0] && !SDL_strcasecmp(game->serial, name)))
+        {
+            return game;
+        }
+    }
+    return 0;
+}
+
+const char *Library_GetKey(const LibraryGame *game)
+{
+    return game->key;
+}
+
+bool Library_GetSavePath(const LibraryGame *game, const char *file, char *buffer, size_t size)
+{
+    SDL_snprintf(buffer, size, "%s/%s", library.options.saves, game->key);
+    if (!SDL_CreateDirectory(buffer))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to create \"%s\": %s", buffer, SDL_GetError());
+        return false;
+    }
+
+    size_t l = SDL_strlen(buffer);
+    SDL_snprintf(buffer + l, size - l, "/%s", file);
+    return true;
+}
+
+CoreMouseLook Library_GetMouseLook(const LibraryGame *game)
+{
+    const char *serial = game->serial;
+    if (!serial[0])
+    {
+        const char *fname = SDL_strrchr(game->path, '/');
+        fname = fname ? fname + 1 : game->path;
+        if (SDL_strcmp(fname, LIBRARY_LEGACY_ROM) != 0)
+        {
+            return (CoreMouseLook){ 0 };
+        }
+        serial = library_patches[0].serial;
+    }
+
+    for (size_t i = 0; i < SDL_arraysize(library_patches); i++)
+    {
+        if (!SDL_strcmp(library_patches[i].serial, serial))
+        {
+            return library_patches[i].mouse_look;
+        }
+    }
+    return (CoreMouseLook){ 0 };
+}
+
+static LibraryGame *LibraryAdd()
+{
+    if (library.count == library.capacity)
+    {
+        library.capacity = library.capacity ? library.capacity * 2 : 16;
+        library.games = SDL_realloc(library.games, library.capacity * sizeof(*library.games));
+        SDL_assert_release(library.games);
+    }
+
+    LibraryGame *game = &library.games[library.count++];
+    SDL_memset(game, 0, sizeof(*game));
+    return game;
+}
+
+static char *LibraryNextField(char **cursor)
+{
+    char *field = *cursor;
+    char *end = field;
+    while (*end && *end != '\t' && *end != '\r' && *end != '\n')
+    {
+        end++;
+    }
+    *cursor = *end ? end + 1 : end;
+    *end = '\0';
+    return field;
+}
+
+static bool LibraryLoadIndex(const char *path, LibraryGame **games, int *count)
+{
+    *games = 0;
+    *count = 0;
+
+    char *text = SDL_LoadFile(path, 0);
+    if (!text)
+    {
+        return false;
+    }
+
+    char *save = 0;
+    char *line = SDL_strtok_r(text, "\n", &save);
+    if (!line || SDL_strncmp(line, LIBRARY_INDEX_HEADER, SDL_strlen(LIBRARY_INDEX_HEADER)) != 0)
+    {
+        SDL_Log("Ignoring outdated library index \"%s\"", path);
+        SDL_free(text);
+        return false;
+    }
+
+    int capacity = 0;
+    while ((line = SDL_strtok_r(0, "\n", &save)))
+    {
+        if (*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 16;
+            *games = SDL_realloc(*games, capacity * sizeof(**games));
+            SDL_assert_release(*games);
+        }
+
+        LibraryGame *game = &(*games)[*count];
+        SDL_memset(game, 0, sizeof(*game));
+
+        char *cursor = line;
+        SDL_strlcpy(game->path, LibraryNextField(&cursor), sizeof(game->path));
+        game->size = SDL_strtoull(LibraryNextField(&cursor), 0, 10);
+        game->mtime = SDL_strtoll(LibraryNextField(&cursor), 0, 10);
+        SDL_strlcpy(game->format, LibraryNextField(&cursor), sizeof(game->format));
+        SDL_strlcpy(game->serial, LibraryNextField(&cursor), sizeof(game->serial));
+        game->chd_version = (Uint32)SDL_strtoull(LibraryNextField(&cursor), 0, 10);
+        game->logical_size = SDL_strtoull(LibraryNextField(&cursor), 0, 10);
+        game->tracks = (Uint32)SDL_strtoull(LibraryNextField(&cursor), 0, 10);
+        SDL_strlcpy(game->sha1, LibraryNextField(&cursor), sizeof(game->sha1));
+        if (game->path[0])
+        {
+            LibraryMakeKey(game);
+            (*count)++;
+        }
+    }
+
+    SDL_free(text);
+    return true;
+}
+
+static bool LibrarySaveIndex()
+{
+    SDL_IOStream *io = SDL_IOFromFile(library.options.index, "w");
+    if (!io)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to open \"%s\": %s", library.options.index, SDL_GetError());
+        return false;
+    }
+
+    SDL_IOprintf(io, "%s\n", LIBRARY_INDEX_HEADER);
+    for (int i = 0; i < library.count; i++)
+    {
+        const LibraryGame *g = &library.games[i];
+        SDL_IOprintf(
+            io,
+            "%s\t%" SDL_PRIu64 "\t%" SDL_PRIs64 "\t%s\t%s\t%" SDL_PRIu32 "\t%" SDL_PRIu64 "\t%" SDL_PRIu32 "\t%s\n",
+            g->path,
+            g->size,
+            g->mtime,
+            g->format,
+            g->serial,
+            g->chd_version,
+            g->logical_size,
+            g->tracks,
+            g->sha1
+        );
+    }
+
+    if (!SDL_CloseIO(io))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to write \"%s\": %s", library.options.index, SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+static bool LibraryScan(LibraryGame *game)
+{
+    SDL_Log("Scanning \"%s\" ...", game->path);
+
+    LibraryDisc disc = { 0 };
+    bool ok = SDL_strcasecmp(game->format, "chd") == 0
+        ? LibraryScanChd(game, &disc)
+        : LibraryScanCue(game, &disc);
+    if (ok)
+    {
+        LibraryReadSerial(&disc, game->serial, sizeof(game->serial));
+    }
+
+    SDL_CloseIO(disc.io);
+#ifdef EMULATOR_LIBCHDR
+    if (disc.chd)
+    {
+        chd_close(disc.chd);
+    }
+    SDL_free(disc.hunk);
+#endif
+    return ok;
+}
+
+static Uint64 LibraryReadBE(const Uint8 *p, int bytes)
+{
+    Uint64 v = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static Uint32 LibraryReadLE32(const Uint8 *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+static void LibraryTrackOffset(LibraryDisc *disc, const char *type)
+{
+    if (SDL_strstr(type, "MODE2_RAW") || SDL_strstr(type, "MODE2/2352"))
+    {
+        disc->data_offset = 24;
+    }
+    else if (SDL_strstr(type, "MODE1_RAW") || SDL_strstr(type, "MODE1/2352"))
+    {
+        disc->data_offset = 16;
+    }
+    else
+    {
+        disc->data_offset = 0;
+    }
+}
+
+static bool LibraryScanChd(LibraryGame *game, LibraryDisc *disc)
+{
+    disc->io = SDL_IOFromFile(game->path, "rb");
+    if (!disc->io)
+    {
+        return false;
+    }
+
+    Uint8 h[124] = { 0 };
+    if (SDL_ReadIO(disc->io, h, 16) != 16 || SDL_memcmp(h, LIBRARY_CHD_MAGIC, 8) != 0)
+    {
+        return false;
+    }
+
+    Uint32 length = (Uint32)LibraryReadBE(h + 8, 4);
+    game->chd_version = (Uint32)LibraryReadBE(h + 12, 4);
+    length = SDL_min(length, sizeof(h));
+    if (length < 16 || SDL_ReadIO(disc->io, h + 16, length - 16) != length - 16)
+    {
+        return false;
+    }
+
+    Uint64 meta = 0;
+    const Uint8 *sha1 = 0;
+    switch (game->chd_version)
+    {
+    case 3:
+        game->logical_size = LibraryReadBE(h + 28, 8);
+        meta = LibraryReadBE(h + 36, 8);
+        sha1 = length >= 100 ? h + 80 : 0;
+        break;
+    case 4:
+        game->logical_size = LibraryReadBE(h + 28, 8);
+        meta = LibraryReadBE(h + 36, 8);
+        sha1 = length >= 68 ? h + 48 : 0;
+        break;
+    case 5:
+        game->logical_size = LibraryReadBE(h + 32, 8);
+        meta = LibraryReadBE(h + 48, 8);
+        sha1 = length >= 104 ? h + 84 : 0;
+        break;
+    default:
+        SDL_Log("Unsupported CHD version %" SDL_PRIu32 " in \"%s\"", game->chd_version, game->path);
+        return false;
+    }
+
+    // The header already carries the SHA-1 of the whole image, so nothing needs to be hashed.
+    if (sha1)
+    {
+        for (int i = 0; i < 20; i++)
+        {
+            SDL_snprintf(game->sha1 + i * 2, 3, "%02x", sha1[i]);
+        }
+    }
+
+    // Track metadata is stored uncompressed as a linked list of entries.
+    for (int n = 0; meta && n < 256; n++)
+    {
+        Uint8 entry[16];
+        if (SDL_SeekIO(disc->io, meta, SDL_IO_SEEK_SET) < 0 || SDL_ReadIO(disc->io, entry, 16) != 16)
+        {
+            break;
+        }
+
+        Uint32 tag = (Uint32)LibraryReadBE(entry, 4);
+        Uint32 size = (Uint32)LibraryReadBE(entry + 5, 3);
+        if (tag == LIBRARY_CHD_CHT2 || tag == LIBRARY_CHD_CHTR)
+        {
+            char text[256] = { '\0' };
+            SDL_ReadIO(disc->io, text, SDL_min(size, sizeof(text) - 1));
+            if (!game->tracks++)
+            {
+                LibraryTrackOffset(disc, text);
+            }
+        }
+        meta = LibraryReadBE(entry + 8, 8);
+    }
+
+#ifdef EMULATOR_LIBCHDR
+    if (chd_open(game->path, CHD_OPEN_READ, 0, &disc->chd) == CHDERR_NONE)
+    {
+        const chd_header *header = chd_get_header(disc->chd);
+        disc->hunk_bytes = header->hunkbytes;
+        disc->unit_bytes = header->unitbytes;
+        disc->hunk_index = SDL_MAX_UINT32;
+        disc->hunk = SDL_malloc(disc->hunk_bytes);
+    }
+#endif
+    return true;
+}
+
+static bool LibraryScanCue(LibraryGame *game, LibraryDisc *disc)
+{
+    char *text = SDL_LoadFile(game->path, 0);
+    if (!text)
+    {
+        return false;
+    }
+
+    char bin[256] = { '\0' };
+    const char *file = SDL_strstr(text, "FILE \"");
+    if (file)
+    {
+        file += 6;
+        const char *end = SDL_strchr(file, '"');
+        const char *slash = SDL_strrchr(game->path, '/');
+        int dir = slash ? (int)(slash - game->path + 1) : 0;
+        if (end)
+        {
+            SDL_snprintf(bin, sizeof(bin), "%.*s%.*s", dir, game->path, (int)(end - file), file);
+        }
+    }
+
+    for (const char *t = SDL_strstr(text, "TRACK "); t; t = SDL_strstr(t + 6, "TRACK "))
+    {
+        if (!game->tracks++)
+        {
+            char type[32] = { '\0' };
+            SDL_sscanf(t, "TRACK %*d %31s", type);
+            LibraryTrackOffset(disc, type);
+            disc->sector_size = SDL_strstr(type, "2048") ? 2048 : 2352;
+        }
+    }
+    SDL_free(text);
+
+    SDL_PathInfo info;
+    if (!bin[0] || !SDL_GetPathInfo(bin, &info))
+    {
+        return false;
+    }
+    game->logical_size = info.size;
+
+    disc->io = SDL_IOFromFile(bin, "rb");
+    return disc->io != 0;
+}
+
+static bool LibraryReadSector(LibraryDisc *disc, Uint32 lba, Uint8 *out)
+{
+#ifdef EMULATOR_LIBCHDR
+    if (disc->chd)
+    {
+        Uint64 offset = (Uint64)lba * disc->unit_bytes;
+        Uint32 hunk = (Uint32)(offset / disc->hunk_bytes);
+        Uint32 within = (Uint32)(offset % disc->hunk_bytes) + disc->data_offset;
+        if (!disc->hunk || within + LIBRARY_SECTOR > disc->hunk_bytes)
+        {
+            return false;
+        }
+        if (hunk != disc->hunk_index)
+        {
+            if (chd_read(disc->chd, hunk, disc->hunk) != CHDERR_NONE)
+            {
+                return false;
+            }
+            disc->hunk_index = hunk;
+        }
+        SDL_memcpy(out, disc->hunk + within, LIBRARY_SECTOR);
+        return true;
+    }
+#endif
+
+    if (!disc->io || !disc->sector_size)
+    {
+        return false;
+    }
+    Sint64 offset = (Sint64)lba * disc->sector_size + disc->data_offset;
+    return SDL_SeekIO(disc->io, offset, SDL_IO_SEEK_SET) == offset
+        && SDL_ReadIO(disc->io, out, LIBRARY_SECTOR) == LIBRARY_SECTOR;
+}
+
+// Reads the boot executable name (e.g. "cdrom:\SCUS_941.82;1") from SYSTEM.CNF.
+static void LibraryReadSerial(LibraryDisc *disc, char *serial, size_t size)
+{
+    Uint8 sector[LIBRARY_SECTOR + 1];
+    if (!LibraryReadSector(disc, 16, sector) || SDL_memcmp(sector + 1, "CD001", 5) != 0)
+    {
+        return;
+    }
+
+    Uint32 root = LibraryReadLE32(sector + 156 + 2);
+    Uint32 root_size = LibraryReadLE32(sector + 156 + 10);
+    Uint32 cnf = 0;
+    for (Uint32 s = 0; !cnf && s < SDL_min((root_size + LIBRARY_SECTOR - 1) / LIBRARY_SECTOR, 16); s++)
+    {
+        if (!LibraryReadSector(disc, root + s, sector))
+        {
+            return;
+        }
+        // Records are at least 34 bytes long and never cross a sector, so anything else ends the listing.
+        for (Uint32 o = 0; o + 33 < LIBRARY_SECTOR && sector[o] >= 34; o += sector[o])
+        {
+            Uint8 length = sector[o + 32];
+            if (o + 33 + length > LIBRARY_SECTOR)
+            {
+                break;
+            }
+            if (length >= 10 && !SDL_strncmp((const char *)sector + o + 33, "SYSTEM.CNF", 10))
+            {
+                cnf = LibraryReadLE32(sector + o + 2);
+                break;
+            }
+        }
+    }
+    if (!cnf || !LibraryReadSector(disc, cnf, sector))
+    {
+        return;
+    }
+
+    sector[LIBRARY_SECTOR] = '\0';
+    const char *boot = SDL_strstr((const char *)sector, "BOOT");
+    const char *name = boot ? SDL_strstr(boot, "cdrom:") : 0;
+    if (!name)
+    {
+        return;
+    }
+    name += 6;
+    while (*name == '\\' || *name == '/')
+    {
+        name++;
+    }
+
+    size_t n = 0;
+    for (; *name && *name != ';' && !SDL_isspace(*name) && n + 1 < size; name++)
+    {
+        if (*name == '\\' || *name == '/')
+        {
+            n = 0;
+        }
+        else if (*name == '_')
+        {
+            serial[n++] = '-';
+        }
+        else if (*name != '.')
+        {
+            serial[n++] = (char)SDL_toupper(*name);
+        }
+    }
+    serial[n] = '\0';
+}
+
+static void LibraryMakeKey(LibraryGame *game)
+{
+    if (game->serial[0])
+    {
+        SDL_strlcpy(game->key, game->serial, sizeof(game->key));
+        return;
+    }
+    if (game->sha1[0])
+    {
+        SDL_snprintf(game->key, sizeof(game->key), "chd-%.12s", game->sha1);
+        return;
+    }
+
+    const char *fname = SDL_strrchr(game->path, '/');
+    fname = fname ? fname + 1 : game->path;
+    const char *ext = SDL_strrchr(fname, '.');
+    int length = ext ? (int)(ext - fname) : (int)SDL_strlen(fname);
+    SDL_snprintf(game->key, sizeof(game->key), "%.*s", length, fname);
+    for (char *c = game->key; *c; c++)
+    {
+        if (!SDL_isalnum(*c) && *c != '-' && *c != '_')
+        {
+            *c = '_';
+        }
+    }
+}
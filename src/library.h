@@ -0,0 +1,35 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+
+#include "core.h"
+
+typedef struct {
+    const char *directory;
+    const char *index;
+    const char *saves;
+} LibraryOptions;
+
+typedef struct {
+    char path[256];
+    Uint64 size;
+    Sint64 mtime;
+    char format[4];
+    char serial[16];
+    Uint32 chd_version;
+    Uint64 logical_size;
+    Uint32 tracks;
+    char sha1[41];
+    char key[48];
+} LibraryGame;
+
+bool Library_Init(LibraryOptions options);
+void Library_Free();
+
+int Library_GetCount();
+const LibraryGame *Library_GetGame(int i);
+const LibraryGame *Library_FindGame(const char *name);
+
+const char *Library_GetKey(const LibraryGame *game);
+bool Library_GetSavePath(const LibraryGame *game, const char *file, char *buffer, size_t size);
+CoreMouseLook Library_GetMouseLook(const LibraryGame *game);
@@ -1,6 +1,7 @@
 #define SDL_MAIN_USE_CALLBACKS
 #include <SDL3/SDL_log.h>
 #include <SDL3/SDL_init.h>
+#include <SDL3/SDL_hints.h>
 #include <SDL3/SDL_main.h>
 #include <SDL3/SDL_timer.h>
 #include <SDL3/SDL_video.h>
@@ -13,6 +14,11 @@
 #include <SDL3/SDL_filesystem.h>
 
 #include "core.h"
+#include "library.h"
+#include "memstats.h"
+#include "netplay.h"
+#include "ramsearch.h"
+#include "trace.h"
 
 static struct {
     SDL_Window *window;
@@ -22,15 +28,110 @@ static struct {
     SDL_Mutex *lock;
     bool waiting_for_dialog;
     Uint64 last_autosave_time;
+    const char *game_name;
+    const LibraryGame *game;
+    bool game_loaded;
+    bool list;
+    char autosave[256];
+    char save_dir[256];
+    struct {
+        bool open;
+        char line[64];
+    } console;
+    bool netplay;
+    NetplayOptions netplay_options;
+    struct {
+        const char *save;
+        SDL_Surface *surface;
+        int frames;
+        int frame;
+        Uint64 start;
+    } replay;
 } app;
 
 static void SaveStateDialogCallback(void *userdata, const char * const *filelist, int filter);
 static void LoadStateDialogCallback(void *userdata, const char * const *filelist, int filter);
+static void RamSearchKey(SDL_Keycode key);
+static void RamSearchCommand(const char *line);
+static bool ConsoleEvent(SDL_Event *event);
+static bool SelectGame();
+static SDL_AppResult ReplayInit();
+static SDL_AppResult ReplayIterate();
 
 SDL_AppResult SDL_AppInit(void **userdata, int argc, char **argv)
 {
+    Memory_Init();
     SDL_SetAppMetadata("SDL3 Libretro Frontend", "0.1.0", "com.xfnty.libretro-frontend");
 
+    app.netplay_options.host = "127.0.0.1";
+    for (int i = 1; i < argc; i++)
+    {
+        if (!SDL_strcmp(argv[i], "--netplay") && i + 3 < argc)
+        {
+            app.netplay = true;
+            app.netplay_options.player = SDL_atoi(argv[++i]);
+            app.netplay_options.local_port = SDL_atoi(argv[++i]);
+            app.netplay_options.remote_port = SDL_atoi(argv[++i]);
+        }
+        else if (!SDL_strcmp(argv[i], "--host") && i + 1 < argc)
+        {
+            app.netplay_options.host = argv[++i];
+        }
+        else if (!SDL_strcmp(argv[i], "--latency") && i + 1 < argc)
+        {
+            app.netplay_options.latency_ms = SDL_atoi(argv[++i]);
+        }
+        else if (!SDL_strcmp(argv[i], "--loss") && i + 1 < argc)
+        {
+            app.netplay_options.loss = SDL_atof(argv[++i]) / 100;
+        }
+        else if (!SDL_strcmp(argv[i], "--replay") && i + 1 < argc)
+        {
+            app.replay.save = argv[++i];
+        }
+        else if (!SDL_strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            app.replay.frames = SDL_atoi(argv[++i]);
+        }
+        else if (!SDL_strcmp(argv[i], "--game") && i + 1 < argc)
+        {
+            app.game_name = argv[++i];
+        }
+        else if (!SDL_strcmp(argv[i], "--list"))
+        {
+            app.list = true;
+        }
+        else
+        {
+            SDL_Log("Unknown argument \"%s\"", argv[i]);
+        }
+    }
+    if (app.netplay && app.netplay_options.player >= CORE_MAX_PORTS)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "netplay player must be 0 or 1");
+        return SDL_APP_FAILURE;
+    }
+
+    Library_Init((LibraryOptions){ .directory = "data", .index = "data/library.idx", .saves = "saves" });
+    if (app.list)
+    {
+        for (int i = 0; i < Library_GetCount(); i++)
+        {
+            const LibraryGame *game = Library_GetGame(i);
+            SDL_Log("%-12s %s (%" SDL_PRIu32 " tracks)", game->key, game->path, game->tracks);
+        }
+        return SDL_APP_SUCCESS;
+    }
+    if (!SelectGame())
+    {
+        return SDL_APP_FAILURE;
+    }
+
+    if (app.replay.save)
+    {
+        return ReplayInit();
+    }
+
     SDL_InitSubSystem(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS);
     SDL_assert_release(
         SDL_CreateWindowAndRenderer(
@@ -49,7 +150,9 @@ SDL_AppResult SDL_AppInit(void **userdata, int argc, char **argv)
     if (!Core_Init(app.renderer, (CoreOptions){ .data = "data", .saves = "saves" }))
         return SDL_APP_FAILURE;
 
-    Core_SetCheatsEnabled(true);
+    // Mouse look pokes RAM outside of the input stream and would desync peers.
+    Core_SetCheatsEnabled(!app.netplay);
+    Core_SetMouseLook(Library_GetMouseLook(app.game));
 
     SDL_ShowWindow(app.window);
     SDL_SetWindowRelativeMouseMode(app.window, true);
@@ -61,7 +164,7 @@ SDL_AppResult SDL_AppInit(void **userdata, int argc, char **argv)
         app.window,
         (SDL_DialogFileFilter[]){ {"Save File", "bin"} },
         1,
-        SDL_GetBasePath(),
+        app.save_dir,
         false
     );
     app.waiting_for_dialog = true;
@@ -73,16 +176,31 @@ SDL_AppResult SDL_AppInit(void **userdata, int argc, char **argv)
 
 SDL_AppResult SDL_AppIterate(void *userdata)
 {
+    if (app.replay.save)
+    {
+        return ReplayIterate();
+    }
+
+    TRACE_BEGIN(SDL_AppIterate);
     SDL_LockMutex(app.lock);
 
-    if (!app.waiting_for_dialog && !app.paused && !app.paused_on_focus_lost)
+    // The peer can't advance without us, so netplay keeps running in the background.
+    bool paused = app.paused || (app.paused_on_focus_lost && !Netplay_IsActive());
+    if (!app.waiting_for_dialog && !paused)
     {
-        Core_RunFrame();
+        if (Netplay_IsActive())
+        {
+            Netplay_RunFrame();
+        }
+        else
+        {
+            Core_RunFrame();
+        }
 
         Uint64 t = SDL_GetTicks();
         if (t - app.last_autosave_time > 60 * 1000)
         {
-            Core_SaveGame("data\\autosave.bin");
+            Core_SaveGame(app.autosave);
             app.last_autosave_time = t;
         }
     }
@@ -92,9 +210,12 @@ SDL_AppResult SDL_AppIterate(void *userdata)
     s.w--;
     s.h--;
     SDL_RenderTexture(app.renderer, Core_GetFramebuffer(), &s, 0);
+    TRACE_BEGIN(SDL_RenderPresent);
     SDL_RenderPresent(app.renderer);
+    TRACE_END(SDL_RenderPresent);
 
     SDL_UnlockMutex(app.lock);
+    TRACE_END(SDL_AppIterate);
     return SDL_APP_CONTINUE;
 }
 
@@ -105,6 +226,13 @@ SDL_AppResult SDL_AppEvent(void *userdata, SDL_Event *event)
         return SDL_APP_SUCCESS;
     }
 
+    TRACE_BEGIN(SDL_AppEvent);
+    if (app.console.open && ConsoleEvent(event))
+    {
+        TRACE_END(SDL_AppEvent);
+        return SDL_APP_CONTINUE;
+    }
+
     if (event->type == SDL_EVENT_KEY_DOWN)
     {
         if (event->key.key == SDLK_F)
@@ -115,7 +243,7 @@ SDL_AppResult SDL_AppEvent(void *userdata, SDL_Event *event)
         {
             SDL_SetWindowRelativeMouseMode(app.window, !SDL_GetWindowRelativeMouseMode(app.window));
         }
-        else if (event->key.key == SDLK_1)
+        else if (event->key.key == SDLK_1 && !app.netplay)
         {
             SDL_LockMutex(app.lock);
             Core_SetCheatsEnabled(!Core_AreCheatsEnabled());
@@ -124,7 +252,7 @@ SDL_AppResult SDL_AppEvent(void *userdata, SDL_Event *event)
         else if (event->key.key == SDLK_2)
         {
             char default_dir[256] = {'\0'};
-            SDL_snprintf(default_dir, sizeof(default_dir), "%s%s\\save.bin", SDL_GetBasePath(), "data");
+            SDL_snprintf(default_dir, sizeof(default_dir), "%ssave.bin", app.save_dir);
             SDL_ShowSaveFileDialog(
                 SaveStateDialogCallback,
                 0,
@@ -146,6 +274,25 @@ SDL_AppResult SDL_AppEvent(void *userdata, SDL_Event *event)
             SDL_UnlockMutex(app.lock);
             SDL_Log("Paused: %d", app.paused);
         }
+        else if (event->key.key == SDLK_GRAVE)
+        {
+            app.console.open = true;
+            app.console.line[0] = '\0';
+            SDL_StartTextInput(app.window);
+            SDL_Log("RAM search console: start [8|16|32], eq <value>, delta <min> <max>, changed, unchanged, increased, decreased");
+        }
+        else if (event->key.key >= SDLK_4 && event->key.key <= SDLK_8)
+        {
+            SDL_LockMutex(app.lock);
+            RamSearchKey(event->key.key);
+            SDL_UnlockMutex(app.lock);
+        }
+#ifdef EMULATOR_TRACE
+        else if (event->key.key == SDLK_3)
+        {
+            Trace_Dump("data/trace.json");
+        }
+#endif
     }
 
     if (event->type == SDL_EVENT_WINDOW_FOCUS_LOST || event->type == SDL_EVENT_WINDOW_FOCUS_GAINED)
@@ -182,18 +329,35 @@ SDL_AppResult SDL_AppEvent(void *userdata, SDL_Event *event)
         SDL_UnlockMutex(app.lock);
     }
 
+    TRACE_END(SDL_AppEvent);
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void *userdata, SDL_AppResult result)
 {
-    if (result == SDL_APP_SUCCESS)
+    if (result == SDL_APP_SUCCESS && app.game_loaded && !app.replay.save)
     {
-        Core_SaveGame("data\\autosave.bin");
+        Core_SaveGame(app.autosave);
     }
 
-    Core_UnloadGame();
+#ifdef EMULATOR_TRACE
+    Trace_Dump("data/trace.json");
+#endif
+
+    RamSearch_End();
+    Netplay_Free();
+    if (app.game_loaded)
+    {
+        Core_UnloadGame();
+    }
     Core_Free();
+    Library_Free();
+    Memory_LogStats();
+    if (app.replay.save)
+    {
+        SDL_DestroyRenderer(app.renderer);
+        SDL_DestroySurface(app.replay.surface);
+    }
     SDL_memset(&app, 0, sizeof(app));
 }
 
@@ -224,8 +388,14 @@ void LoadStateDialogCallback(void *userdata, const char * const *filelist, int f
     SDL_LockMutex(app.lock);
     if (*filelist)
     {
-        Core_LoadGame("data\\rom.chd", *filelist);
+        app.game_loaded = Core_LoadGame(app.game->path, *filelist);
         app.waiting_for_dialog = false;
+
+        if (app.netplay && !Netplay_Init(app.netplay_options))
+        {
+            app.netplay = false;
+            Core_SetCheatsEnabled(true);
+        }
     }
     else
     {
@@ -235,10 +405,261 @@ void LoadStateDialogCallback(void *userdata, const char * const *filelist, int f
             app.window,
             (SDL_DialogFileFilter[]){ {"Save File", "bin"} },
             1,
-            SDL_GetBasePath(),
+            app.save_dir,
             false
         );
         app.waiting_for_dialog = true;
     }
     SDL_UnlockMutex(app.lock);
 }
+
+bool SelectGame()
+{
+    if (app.game_name)
+    {
+        app.game = Library_FindGame(app.game_name);
+    }
+    else
+    {
+        app.game = Library_FindGame("rom.chd");
+        if (!app.game && Library_GetCount())
+        {
+            app.game = Library_GetGame(0);
+        }
+    }
+
+    if (!app.game)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "no game \"%s\" in data/", app.game_name ? app.game_name : "rom.chd");
+        return false;
+    }
+
+    if (!Library_GetSavePath(app.game, "autosave.bin", app.autosave, sizeof(app.autosave)))
+    {
+        return false;
+    }
+
+    // Dialogs want an absolute folder, the rest of the frontend works relative to the working directory.
+    char dir[256];
+    char *cwd = SDL_GetCurrentDirectory();
+    Library_GetSavePath(app.game, "", dir, sizeof(dir));
+    SDL_snprintf(app.save_dir, sizeof(app.save_dir), "%s%s", cwd ? cwd : "", dir);
+    SDL_free(cwd);
+    SDL_Log("Game: %s (%s)", app.game->path, Library_GetKey(app.game));
+    return true;
+}
+
+static void RamSearchStart(RamSearchWidth width)
+{
+    size_t size = 0;
+    Uint8 *ram = Core_GetSystemRam(&size);
+    if (ram && size && RamSearch_Begin(ram, size, width))
+    {
+        SDL_Log("RAM search (%d-bit): %zu candidates", width * 8, RamSearch_GetCount());
+    }
+}
+
+static void RamSearchRun(RamSearchFilter filter, Sint64 a, Sint64 b, const char *name)
+{
+    size_t size = 0;
+    Uint8 *ram = Core_GetSystemRam(&size);
+    if (!ram || !size)
+    {
+        return;
+    }
+    if (!RamSearch_GetCount())
+    {
+        SDL_Log("RAM search: no candidates, start a new search first");
+        return;
+    }
+
+    Uint64 start = SDL_GetTicksNS();
+    size_t count = RamSearch_Filter(ram, filter, a, b);
+    Uint64 elapsed = SDL_GetTicksNS() - start;
+
+    Uint32 addresses[8];
+    size_t n = RamSearch_GetResults(addresses, SDL_arraysize(addresses));
+    char list[128] = {'\0'};
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t l = SDL_strlen(list);
+        SDL_snprintf(list + l, sizeof(list) - l, " 0x%06X", addresses[i]);
+    }
+    SDL_Log(
+        "RAM search (%s): %zu candidates in %.3fms%s%s",
+        name,
+        count,
+        elapsed / 1e6,
+        n ? ":" : "",
+        list
+    );
+}
+
+void RamSearchKey(SDL_Keycode key)
+{
+    if (key == SDLK_4 || !RamSearch_GetCount())
+    {
+        RamSearchStart(RAMSEARCH_16);
+        return;
+    }
+
+    // Keys 5 to 8.
+    const RamSearchFilter filters[] = {
+        RAMSEARCH_CHANGED,
+        RAMSEARCH_UNCHANGED,
+        RAMSEARCH_INCREASED,
+        RAMSEARCH_DECREASED,
+    };
+    const char *names[] = { "changed", "unchanged", "increased", "decreased" };
+    RamSearchRun(filters[key - SDLK_5], 0, 0, names[key - SDLK_5]);
+}
+
+void RamSearchCommand(const char *line)
+{
+    char command[16] = {'\0'};
+    char a[24] = {'\0'};
+    char b[24] = {'\0'};
+    int n = SDL_sscanf(line, "%15s %23s %23s", command, a, b);
+    if (n < 1)
+    {
+        return;
+    }
+    SDL_Log("> %s", line);
+
+    // Values accept decimal, 0x hex and negative numbers.
+    if (!SDL_strcmp(command, "start"))
+    {
+        int bits = n >= 2 ? SDL_atoi(a) : 16;
+        if (bits != 8 && bits != 16 && bits != 32)
+        {
+            SDL_Log("RAM search: width must be 8, 16 or 32");
+            return;
+        }
+        RamSearchStart((RamSearchWidth)(bits / 8));
+    }
+    else if (!SDL_strcmp(command, "eq") && n >= 2)
+    {
+        RamSearchRun(RAMSEARCH_EQUAL, SDL_strtoll(a, 0, 0), 0, "equal");
+    }
+    else if (!SDL_strcmp(command, "delta") && n >= 3)
+    {
+        RamSearchRun(RAMSEARCH_DELTA, SDL_strtoll(a, 0, 0), SDL_strtoll(b, 0, 0), "delta");
+    }
+    else if (!SDL_strcmp(command, "changed"))
+    {
+        RamSearchRun(RAMSEARCH_CHANGED, 0, 0, command);
+    }
+    else if (!SDL_strcmp(command, "unchanged"))
+    {
+        RamSearchRun(RAMSEARCH_UNCHANGED, 0, 0, command);
+    }
+    else if (!SDL_strcmp(command, "increased"))
+    {
+        RamSearchRun(RAMSEARCH_INCREASED, 0, 0, command);
+    }
+    else if (!SDL_strcmp(command, "decreased"))
+    {
+        RamSearchRun(RAMSEARCH_DECREASED, 0, 0, command);
+    }
+    else
+    {
+        SDL_Log("RAM search: unknown command \"%s\"", line);
+    }
+}
+
+// Swallows keyboard input while the console is open so that typing doesn't reach the game.
+bool ConsoleEvent(SDL_Event *event)
+{
+    if (event->type == SDL_EVENT_TEXT_INPUT)
+    {
+        size_t l = SDL_strlen(app.console.line);
+        for (const char *c = event->text.text; *c && l + 1 < sizeof(app.console.line); c++)
+        {
+            if (*c != '`')
+            {
+                app.console.line[l++] = *c;
+            }
+        }
+        app.console.line[l] = '\0';
+        return true;
+    }
+
+    if (event->type == SDL_EVENT_KEY_DOWN)
+    {
+        if (event->key.key == SDLK_RETURN || event->key.key == SDLK_ESCAPE || event->key.key == SDLK_GRAVE)
+        {
+            app.console.open = false;
+            SDL_StopTextInput(app.window);
+            if (event->key.key == SDLK_RETURN)
+            {
+                SDL_LockMutex(app.lock);
+                RamSearchCommand(app.console.line);
+                SDL_UnlockMutex(app.lock);
+            }
+        }
+        else if (event->key.key == SDLK_BACKSPACE)
+        {
+            size_t l = SDL_strlen(app.console.line);
+            if (l)
+            {
+                app.console.line[l - 1] = '\0';
+            }
+        }
+        return true;
+    }
+
+    return event->type == SDL_EVENT_KEY_UP;
+}
+
+SDL_AppResult ReplayInit()
+{
+    SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+    SDL_InitSubSystem(SDL_INIT_AUDIO | SDL_INIT_EVENTS);
+
+    app.replay.surface = SDL_CreateSurface(16, 16, SDL_PIXELFORMAT_XRGB8888);
+    app.renderer = SDL_CreateSoftwareRenderer(app.replay.surface);
+    if (!app.renderer)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateSoftwareRenderer(): %s", SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+
+    if (!Core_Init(app.renderer, (CoreOptions){ .data = "data", .saves = "saves" }))
+        return SDL_APP_FAILURE;
+
+    Core_SetMouseLook(Library_GetMouseLook(app.game));
+    app.game_loaded = SDL_GetPathInfo(app.replay.save, 0) && Core_LoadGame(app.game->path, app.replay.save);
+    if (!app.game_loaded)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to load \"%s\" for replay", app.replay.save);
+        return SDL_APP_FAILURE;
+    }
+
+    if (app.replay.frames <= 0)
+    {
+        app.replay.frames = 3600;
+    }
+    app.replay.start = SDL_GetTicksNS();
+    SDL_Log("Replaying %d frames from \"%s\" ...", app.replay.frames, app.replay.save);
+    return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult ReplayIterate()
+{
+    Core_StepFrame();
+    // The dummy device plays in real time, so unthrottled frames would only grow its queue.
+    Core_ClearAudio();
+    if (++app.replay.frame < app.replay.frames)
+    {
+        return SDL_APP_CONTINUE;
+    }
+
+    double seconds = (SDL_GetTicksNS() - app.replay.start) / 1e9;
+    SDL_Log(
+        "Replay: %d frames in %.3fs (%.1f fps)",
+        app.replay.frame,
+        seconds,
+        app.replay.frame / seconds
+    );
+    return SDL_APP_SUCCESS;
+}
@@ -0,0 +1,306 @@
+#include "memstats.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_assert.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_atomic.h>
+
+static void *MemoryRawMalloc(size_t size);
+static void *MemoryRawCalloc(size_t count, size_t size);
+static void *MemoryRawRealloc(void *mem, size_t size);
+static void MemoryRawFree(void *mem);
+
+// The block table must not go through the hooks that fill it.
+#define kcalloc MemoryRawCalloc
+#define kmalloc MemoryRawMalloc
+#define krealloc MemoryRawRealloc
+#define kfree MemoryRawFree
+#include <klib/khash.h>
+
+// Allocations are at least 16-byte aligned, so the low bits carry no information.
+#define MemoryHash(key) kh_int64_hash_func((key) >> 4)
+
+typedef struct {
+    size_t size;
+    MemoryTag tag;
+} MemoryBlock;
+
+KHASH_INIT(blocks, khint64_t, MemoryBlock, 1, MemoryHash, kh_int64_hash_equal);
+
+static const char *memory_tag_names[MEMORY_TAG_COUNT] = {
+    [MEMORY_OTHER] = "other",
+    [MEMORY_CORE_VARS] = "core vars",
+    [MEMORY_SAVE_STATES] = "save states",
+    [MEMORY_TEXTURES] = "textures",
+    [MEMORY_AUDIO] = "audio",
+};
+
+static struct {
+    SDL_malloc_func malloc_func;
+    SDL_calloc_func calloc_func;
+    SDL_realloc_func realloc_func;
+    SDL_free_func free_func;
+    SDL_SpinLock lock;
+    SDL_TLSID tag;
+    khash_t(blocks) *blocks;
+    MemoryStats tags[MEMORY_TAG_COUNT];
+    size_t live_bytes;
+    size_t peak_bytes;
+    struct {
+        SDL_ThreadID thread;
+        bool active;
+        bool guard;
+        Uint32 allocations;
+        Uint32 count;
+        Uint32 max_allocations;
+        Uint64 late_allocations;
+    } frame;
+} memory;
+
+static void *SDLCALL MemoryMalloc(size_t size);
+static void *SDLCALL MemoryCalloc(size_t count, size_t size);
+static void *SDLCALL MemoryRealloc(void *mem, size_t size);
+static void SDLCALL MemoryFree(void *mem);
+
+bool Memory_Init()
+{
+    if (memory.blocks)
+    {
+        return true;
+    }
+
+    SDL_GetMemoryFunctions(&memory.malloc_func, &memory.calloc_func, &memory.realloc_func, &memory.free_func);
+    memory.blocks = kh_init(blocks);
+    memory.frame.guard = true;
+
+    // Blocks allocated before this point are unknown to the table and are passed through untouched.
+    // The hooks stay installed until exit because SDL frees its own memory after SDL_AppQuit().
+    if (!SDL_SetMemoryFunctions(MemoryMalloc, MemoryCalloc, MemoryRealloc, MemoryFree))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_SetMemoryFunctions(): %s", SDL_GetError());
+        kh_destroy(blocks, memory.blocks);
+        memory.blocks = 0;
+        return false;
+    }
+    return true;
+}
+
+MemoryTag Memory_SetTag(MemoryTag tag)
+{
+    SDL_assert(tag < MEMORY_TAG_COUNT);
+    MemoryTag previous = (MemoryTag)(uintptr_t)SDL_GetTLS(&memory.tag);
+    SDL_SetTLS(&memory.tag, (void *)(uintptr_t)tag, 0);
+    return previous;
+}
+
+MemoryStats Memory_GetStats(MemoryTag tag)
+{
+    SDL_assert(tag < MEMORY_TAG_COUNT);
+    SDL_LockSpinlock(&memory.lock);
+    MemoryStats stats = memory.tags[tag];
+    SDL_UnlockSpinlock(&memory.lock);
+    return stats;
+}
+
+void Memory_LogStats()
+{
+    SDL_LockSpinlock(&memory.lock);
+    MemoryStats tags[MEMORY_TAG_COUNT];
+    SDL_memcpy(tags, memory.tags, sizeof(tags));
+    size_t live_bytes = memory.live_bytes;
+    size_t peak_bytes = memory.peak_bytes;
+    Uint32 frames = memory.frame.count;
+    Uint32 max_allocations = memory.frame.max_allocations;
+    Uint64 late_allocations = memory.frame.late_allocations;
+    SDL_UnlockSpinlock(&memory.lock);
+
+    for (int i = 0; i < MEMORY_TAG_COUNT; i++)
+    {
+        SDL_Log(
+            "Memory: %-12s %10zu B live %10zu B peak %8" SDL_PRIu64 " allocations",
+            memory_tag_names[i],
+            tags[i].live_bytes,
+            tags[i].peak_bytes,
+            tags[i].allocations
+        );
+    }
+    SDL_Log("Memory: %-12s %10zu B live %10zu B peak", "total", live_bytes, peak_bytes);
+    SDL_Log(
+        "Memory: %" SDL_PRIu32 " frames, %" SDL_PRIu64 " allocations after warm-up (max %" SDL_PRIu32 " per frame)",
+        frames,
+        late_allocations,
+        max_allocations
+    );
+}
+
+void Memory_BeginFrame()
+{
+    SDL_LockSpinlock(&memory.lock);
+    memory.frame.thread = SDL_GetCurrentThreadID();
+    memory.frame.allocations = 0;
+    memory.frame.active = true;
+    SDL_UnlockSpinlock(&memory.lock);
+}
+
+Uint32 Memory_EndFrame(bool ran)
+{
+    SDL_LockSpinlock(&memory.lock);
+    Uint32 allocations = memory.frame.allocations;
+    memory.frame.active = false;
+    if (memory.frame.count >= MEMORY_WARMUP_FRAMES)
+    {
+        memory.frame.late_allocations += allocations;
+        memory.frame.max_allocations = SDL_max(memory.frame.max_allocations, allocations);
+    }
+    if (ran)
+    {
+        memory.frame.count++;
+    }
+    SDL_UnlockSpinlock(&memory.lock);
+    return allocations;
+}
+
+void Memory_SetFrameGuard(bool enabled)
+{
+    SDL_LockSpinlock(&memory.lock);
+    memory.frame.guard = enabled;
+    SDL_UnlockSpinlock(&memory.lock);
+}
+
+static void MemoryTrack(void *mem, size_t size, MemoryTag tag)
+{
+    SDL_ThreadID thread = SDL_GetCurrentThreadID();
+
+    SDL_LockSpinlock(&memory.lock);
+    int ret = 0;
+    khiter_t it = kh_put(blocks, memory.blocks, (uintptr_t)mem, &ret);
+    if (ret >= 0)
+    {
+        kh_value(memory.blocks, it) = (MemoryBlock){ size, tag };
+
+        MemoryStats *stats = &memory.tags[tag];
+        stats->live_bytes += size;
+        stats->peak_bytes = SDL_max(stats->peak_bytes, stats->live_bytes);
+        stats->allocations++;
+        memory.live_bytes += size;
+        memory.peak_bytes = SDL_max(memory.peak_bytes, memory.live_bytes);
+    }
+
+    // Only the first one is reported so that allocations made by the report itself don't recurse.
+    bool late = false;
+    if (memory.frame.active && memory.frame.thread == thread)
+    {
+        late = ++memory.frame.allocations == 1
+            && memory.frame.guard
+            && memory.frame.count >= MEMORY_WARMUP_FRAMES;
+    }
+    SDL_UnlockSpinlock(&memory.lock);
+
+#if SDL_ASSERT_LEVEL >= 2
+    if (late)
+    {
+        SDL_LogError(
+            SDL_LOG_CATEGORY_APPLICATION,
+            "%zu B allocation (%s) inside frame %" SDL_PRIu32,
+            size,
+            memory_tag_names[tag],
+            memory.frame.count
+        );
+        SDL_assert(!"allocation inside the frame loop after warm-up");
+    }
+#else
+    (void)late;
+#endif
+}
+
+static bool MemoryUntrack(void *mem, MemoryBlock *block)
+{
+    SDL_LockSpinlock(&memory.lock);
+    khiter_t it = kh_get(blocks, memory.blocks, (uintptr_t)mem);
+    bool found = it != kh_end(memory.blocks);
+    if (found)
+    {
+        MemoryBlock b = kh_value(memory.blocks, it);
+        kh_del(blocks, memory.blocks, it);
+        memory.tags[b.tag].live_bytes -= b.size;
+        memory.live_bytes -= b.size;
+        if (block)
+        {
+            *block = b;
+        }
+    }
+    SDL_UnlockSpinlock(&memory.lock);
+    return found;
+}
+
+static MemoryTag MemoryGetTag()
+{
+    return (MemoryTag)(uintptr_t)SDL_GetTLS(&memory.tag);
+}
+
+static void *SDLCALL MemoryMalloc(size_t size)
+{
+    void *mem = memory.malloc_func(size);
+    if (mem)
+    {
+        MemoryTrack(mem, size, MemoryGetTag());
+    }
+    return mem;
+}
+
+static void *SDLCALL MemoryCalloc(size_t count, size_t size)
+{
+    void *mem = memory.calloc_func(count, size);
+    if (mem)
+    {
+        MemoryTrack(mem, count * size, MemoryGetTag());
+    }
+    return mem;
+}
+
+static void *SDLCALL MemoryRealloc(void *mem, size_t size)
+{
+    // Resized blocks stay with the subsystem that allocated them.
+    MemoryBlock block = { 0, MemoryGetTag() };
+    bool known = mem && MemoryUntrack(mem, &block);
+
+    void *result = memory.realloc_func(mem, size);
+    if (result)
+    {
+        MemoryTrack(result, size, block.tag);
+    }
+    else if (known)
+    {
+        MemoryTrack(mem, block.size, block.tag);
+    }
+    return result;
+}
+
+static void SDLCALL MemoryFree(void *mem)
+{
+    if (mem)
+    {
+        MemoryUntrack(mem, 0);
+        memory.free_func(mem);
+    }
+}
+
+static void *MemoryRawMalloc(size_t size)
+{
+    return memory.malloc_func(size);
+}
+
+static void *MemoryRawCalloc(size_t count, size_t size)
+{
+    return memory.calloc_func(count, size);
+}
+
+static void *MemoryRawRealloc(void *mem, size_t size)
+{
+    return memory.realloc_func(mem, size);
+}
+
+static void MemoryRawFree(void *mem)
+{
+    memory.free_func(mem);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+
+#define MEMORY_WARMUP_FRAMES 120
+
+typedef enum {
+    MEMORY_OTHER,
+    MEMORY_CORE_VARS,
+    MEMORY_SAVE_STATES,
+    MEMORY_TEXTURES,
+    MEMORY_AUDIO,
+    MEMORY_TAG_COUNT,
+} MemoryTag;
+
+typedef struct {
+    size_t live_bytes;
+    size_t peak_bytes;
+    Uint64 allocations;
+} MemoryStats;
+
+bool Memory_Init();
+
+// Returns the previous tag of the calling thread so that it can be restored.
+MemoryTag Memory_SetTag(MemoryTag tag);
+MemoryStats Memory_GetStats(MemoryTag tag);
+void Memory_LogStats();
+
+// Counts allocations made by the calling thread until Memory_EndFrame(). With the guard on,
+// debug builds assert on any of them once MEMORY_WARMUP_FRAMES emulated frames have passed.
+// Pass ran = false for calls that were throttled or stalled so they don't count as frames.
+void Memory_BeginFrame();
+Uint32 Memory_EndFrame(bool ran);
+void Memory_SetFrameGuard(bool enabled);
@@ -0,0 +1,551 @@
+#include "netplay.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+#include <SDL3/SDL_assert.h>
+#include <SDL3/SDL_endian.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET NetSocket;
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+typedef int NetSocket;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+#include "core.h"
+#include "trace.h"
+#include "memstats.h"
+
+#define NETPLAY_MAGIC 0x504E4341 // "ACNP"
+#define NETPLAY_INPUT_RING 128
+#define NETPLAY_STATE_RING (NETPLAY_MAX_ROLLBACK + 2)
+#define NETPLAY_MAX_INPUTS_PER_PACKET 64
+#define NETPLAY_MAX_PACKET (4 + 4 + 4 + 1 + 1 + NETPLAY_MAX_INPUTS_PER_PACKET * 2 + 4 + 4)
+#define NETPLAY_DELAY_QUEUE 64
+#define NETPLAY_CHECKSUM_INTERVAL 60
+#define NETPLAY_CHECKSUM_RING 8
+
+typedef struct {
+    Uint64 due;
+    int size;
+    Uint8 data[NETPLAY_MAX_PACKET];
+} NetplayPacket;
+
+static struct {
+    NetplayOptions options;
+    NetSocket socket;
+    struct sockaddr_in remote;
+    bool open;
+    bool active;
+    size_t state_size;
+    Uint8 *states[NETPLAY_STATE_RING];
+    Uint16 local[NETPLAY_INPUT_RING];
+    Uint16 remote_inputs[NETPLAY_INPUT_RING];
+    Uint16 predicted[NETPLAY_INPUT_RING];
+    Sint32 frame;
+    Sint32 remote_frame;
+    Sint32 remote_head;
+    Sint32 remote_ack;
+    Sint32 rollback_frame;
+    int remote_advantage;
+    Uint64 last_frame_ns;
+    Uint64 last_send_ns;
+    NetplayPacket queue[NETPLAY_DELAY_QUEUE];
+    struct {
+        Sint32 frame;
+        Uint32 hash;
+    } checksums[NETPLAY_CHECKSUM_RING];
+    Sint32 checksum_frame;
+    bool desynced;
+    struct {
+        Uint64 rollbacks;
+        Uint64 rolled_back_frames;
+        Uint64 max_rollback_ns;
+        Uint64 stalls;
+    } stats;
+} netplay;
+
+static bool NetplayRunFrame();
+static void NetplaySimulate(Sint32 frame);
+static void NetplaySaveState(Sint32 frame);
+static void NetplayRollback();
+static void NetplayChecksum(Sint32 frame);
+static Uint32 NetplayHash(const Uint8 *data, size_t size);
+static void NetplayReceive();
+static void NetplaySend();
+static void NetplayQueuePacket(const Uint8 *data, int size);
+static void NetplayFlushQueue();
+
+bool Netplay_Init(NetplayOptions options)
+{
+    Netplay_Free();
+
+    SDL_Log(
+        "Initializing Netplay (player=%u local=%u remote=%s:%u latency=%ums loss=%.0f%%) ...",
+        options.player,
+        options.local_port,
+        options.host,
+        options.remote_port,
+        options.latency_ms,
+        options.loss * 100
+    );
+    SDL_assert(options.player < CORE_MAX_PORTS);
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "WSAStartup() failed");
+        return false;
+    }
+#endif
+
+    netplay.options = options;
+    netplay.socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (netplay.socket == INVALID_SOCKET)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "socket() failed");
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+    netplay.open = true;
+
+#ifdef _WIN32
+    u_long nonblocking = 1;
+    ioctlsocket(netplay.socket, FIONBIO, &nonblocking);
+#else
+    fcntl(netplay.socket, F_SETFL, fcntl(netplay.socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons(options.local_port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(netplay.socket, (struct sockaddr *)&local, sizeof(local)) != 0)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bind() failed on port %u", options.local_port);
+        Netplay_Free();
+        return false;
+    }
+
+    netplay.remote = (struct sockaddr_in){
+        .sin_family = AF_INET,
+        .sin_port = htons(options.remote_port),
+    };
+    if (inet_pton(AF_INET, options.host, &netplay.remote.sin_addr) != 1)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "invalid netplay host \"%s\"", options.host);
+        Netplay_Free();
+        return false;
+    }
+
+    netplay.state_size = Core_GetStateSize();
+    MemoryTag tag = Memory_SetTag(MEMORY_SAVE_STATES);
+    for (int i = 0; i < NETPLAY_STATE_RING; i++)
+    {
+        netplay.states[i] = SDL_malloc(netplay.state_size);
+        SDL_assert_release(netplay.states[i]);
+    }
+    Memory_SetTag(tag);
+
+    netplay.remote_frame = -1;
+    netplay.remote_head = -1;
+    netplay.remote_ack = -1;
+    netplay.rollback_frame = SDL_MAX_SINT32;
+    for (int i = 0; i < NETPLAY_CHECKSUM_RING; i++)
+    {
+        netplay.checksums[i].frame = -1;
+    }
+    netplay.active = true;
+
+    SDL_Log("Netplay state size: %zu bytes", netplay.state_size);
+    return true;
+}
+
+void Netplay_Free()
+{
+    if (netplay.active)
+    {
+        SDL_Log(
+            "Netplay: %lld frames, %llu rollbacks (%llu frames, max %.2fms), %llu stalls",
+            (long long)netplay.frame,
+            (unsigned long long)netplay.stats.rollbacks,
+            (unsigned long long)netplay.stats.rolled_back_frames,
+            netplay.stats.max_rollback_ns / 1000000.0,
+            (unsigned long long)netplay.stats.stalls
+        );
+    }
+
+    if (netplay.open)
+    {
+        closesocket(netplay.socket);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    for (int i = 0; i < NETPLAY_STATE_RING; i++)
+    {
+        SDL_free(netplay.states[i]);
+    }
+
+    SDL_memset(&netplay, 0, sizeof(netplay));
+}
+
+bool Netplay_IsActive()
+{
+    return netplay.active;
+}
+
+bool Netplay_RunFrame()
+{
+    SDL_assert(netplay.active);
+
+    Memory_BeginFrame();
+    bool ran = NetplayRunFrame();
+    Memory_EndFrame(ran);
+    return ran;
+}
+
+void Netplay_Rollback(int frames)
+{
+    SDL_assert(netplay.active && frames > 0 && frames <= NETPLAY_MAX_ROLLBACK && frames <= netplay.frame);
+
+    netplay.rollback_frame = netplay.frame - frames;
+    NetplayRollback();
+    NetplaySaveState(netplay.frame);
+    NetplaySimulate(netplay.frame);
+    NetplayChecksum(netplay.frame - frames);
+}
+
+static bool NetplayRunFrame()
+{
+    NetplayFlushQueue();
+    NetplayReceive();
+
+    Uint64 now = SDL_GetTicksNS();
+    Uint64 interval = (Uint64)(SDL_NS_PER_SECOND / Core_GetFrameRate());
+    if (now - netplay.last_frame_ns < interval)
+    {
+        if (now - netplay.last_send_ns >= interval)
+        {
+            NetplaySend();
+        }
+        return false;
+    }
+
+    // Can't predict further than we are able to roll back.
+    if (netplay.frame - (netplay.remote_frame + 1) >= NETPLAY_MAX_ROLLBACK)
+    {
+        netplay.stats.stalls++;
+        NetplaySend();
+        return false;
+    }
+
+    // Give the peer a frame to catch up when we are running ahead of it.
+    int advantage = netplay.frame - netplay.remote_head;
+    if (netplay.frame % 8 == 0 && advantage - netplay.remote_advantage >= 2)
+    {
+        netplay.stats.stalls++;
+        netplay.last_frame_ns = now;
+        NetplaySend();
+        return false;
+    }
+
+    Uint16 local = Core_GetInputState(0);
+
+    if (netplay.rollback_frame < netplay.frame)
+    {
+        NetplayRollback();
+    }
+
+    netplay.local[netplay.frame % NETPLAY_INPUT_RING] = local;
+    NetplaySaveState(netplay.frame);
+    NetplaySimulate(netplay.frame);
+
+    // Every input before a checksum frame is confirmed, so both peers must hold the same state there
+    // and no later rollback can change it.
+    if (netplay.checksum_frame <= netplay.frame && netplay.checksum_frame - 1 <= netplay.remote_frame)
+    {
+        NetplayChecksum(netplay.checksum_frame);
+        netplay.checksum_frame += NETPLAY_CHECKSUM_INTERVAL;
+    }
+    netplay.frame++;
+
+    Core_SetInputState(0, local);
+
+    netplay.last_frame_ns = now;
+    NetplaySend();
+    return true;
+}
+
+static void NetplaySimulate(Sint32 frame)
+{
+    Uint16 remote = 0;
+    if (frame <= netplay.remote_frame)
+    {
+        remote = netplay.remote_inputs[frame % NETPLAY_INPUT_RING];
+    }
+    else if (netplay.remote_frame >= 0)
+    {
+        remote = netplay.remote_inputs[netplay.remote_frame % NETPLAY_INPUT_RING];
+    }
+    netplay.predicted[frame % NETPLAY_INPUT_RING] = remote;
+
+    unsigned player = netplay.options.player;
+    Core_SetInputState(player, netplay.local[frame % NETPLAY_INPUT_RING]);
+    Core_SetInputState(1 - player, remote);
+    Core_StepFrame();
+}
+
+static void NetplaySaveState(Sint32 frame)
+{
+    if (!Core_SerializeState(netplay.states[frame % NETPLAY_STATE_RING], netplay.state_size))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Netplay: failed to save frame %d", (int)frame);
+    }
+}
+
+static void NetplayRollback()
+{
+    TRACE_BEGIN(Netplay_Rollback);
+    Uint64 start = SDL_GetTicksNS();
+    Sint32 target = netplay.frame;
+
+    Core_UnserializeState(
+        netplay.states[netplay.rollback_frame % NETPLAY_STATE_RING],
+        netplay.state_size
+    );
+    Core_SetReplaying(true);
+    for (Sint32 f = netplay.rollback_frame; f < target; f++)
+    {
+        if (f != netplay.rollback_frame)
+        {
+            NetplaySaveState(f);
+        }
+        NetplaySimulate(f);
+    }
+    Core_SetReplaying(false);
+
+    Uint64 elapsed = SDL_GetTicksNS() - start;
+    netplay.stats.rollbacks++;
+    netplay.stats.rolled_back_frames += target - netplay.rollback_frame;
+    netplay.stats.max_rollback_ns = SDL_max(netplay.stats.max_rollback_ns, elapsed);
+    netplay.rollback_frame = SDL_MAX_SINT32;
+    TRACE_END(Netplay_Rollback);
+}
+
+static void NetplayChecksum(Sint32 frame)
+{
+    SDL_assert(netplay.frame - frame < NETPLAY_STATE_RING);
+
+    int i = (frame / NETPLAY_CHECKSUM_INTERVAL) % NETPLAY_CHECKSUM_RING;
+    netplay.checksums[i].frame = frame;
+    netplay.checksums[i].hash = NetplayHash(netplay.states[frame % NETPLAY_STATE_RING], netplay.state_size);
+}
+
+// FNV-1a over 64-bit words. SDL_crc32() goes byte by byte and is too slow for multi-megabyte states.
+static Uint32 NetplayHash(const Uint8 *data, size_t size)
+{
+    Uint64 hash = 0xCBF29CE484222325;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        Uint64 word;
+        SDL_memcpy(&word, data + i, 8);
+        hash = (hash ^ SDL_Swap64LE(word)) * 0x100000001B3;
+    }
+    for (; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 0x100000001B3;
+    }
+    return (Uint32)(hash ^ (hash >> 32));
+}
+
+static Uint32 NetplayRead32(const Uint8 *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+static void NetplayWrite32(Uint8 *p, Uint32 v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void NetplayReceive()
+{
+    Uint8 p[NETPLAY_MAX_PACKET];
+    for (;;)
+    {
+        struct sockaddr_in from = { 0 };
+        socklen_t from_size = sizeof(from);
+        int size = recvfrom(netplay.socket, (char *)p, sizeof(p), 0, (struct sockaddr *)&from, &from_size);
+        if (size < 0)
+        {
+            break;
+        }
+
+        // Only the configured peer may feed inputs and checksums into the session.
+        if (from_size != sizeof(from)
+            || from.sin_addr.s_addr != netplay.remote.sin_addr.s_addr
+            || from.sin_port != netplay.remote.sin_port)
+        {
+            continue;
+        }
+        if (size < 14 || NetplayRead32(p) != NETPLAY_MAGIC)
+        {
+            continue;
+        }
+
+        Sint32 ack = (Sint32)NetplayRead32(p + 4);
+        Sint32 start = (Sint32)NetplayRead32(p + 8);
+        int advantage = (Sint8)p[12];
+        int count = p[13];
+        if (size != 14 + count * 2 + 8)
+        {
+            continue;
+        }
+
+        netplay.remote_ack = SDL_max(netplay.remote_ack, ack);
+        if (start + count - 1 > netplay.remote_head)
+        {
+            netplay.remote_head = start + count - 1;
+            netplay.remote_advantage = advantage;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            Sint32 f = start + i;
+            if (f != netplay.remote_frame + 1)
+            {
+                continue;
+            }
+
+            Uint16 input = p[14 + i * 2] | (p[15 + i * 2] << 8);
+            netplay.remote_inputs[f % NETPLAY_INPUT_RING] = input;
+            netplay.remote_frame = f;
+            if (f < netplay.frame && netplay.predicted[f % NETPLAY_INPUT_RING] != input)
+            {
+                netplay.rollback_frame = SDL_min(netplay.rollback_frame, f);
+            }
+        }
+
+        Sint32 hash_frame = (Sint32)NetplayRead32(p + 14 + count * 2);
+        Uint32 hash = NetplayRead32(p + 18 + count * 2);
+        if (hash_frame >= 0 && !netplay.desynced)
+        {
+            int i = (hash_frame / NETPLAY_CHECKSUM_INTERVAL) % NETPLAY_CHECKSUM_RING;
+            if (netplay.checksums[i].frame == hash_frame && netplay.checksums[i].hash != hash)
+            {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Netplay: desync at frame %d", (int)hash_frame);
+                netplay.desynced = true;
+            }
+        }
+    }
+}
+
+static void NetplaySend()
+{
+    Uint8 p[NETPLAY_MAX_PACKET];
+    Sint32 start = netplay.remote_ack + 1;
+    int count = SDL_min(netplay.frame - start, NETPLAY_MAX_INPUTS_PER_PACKET);
+    if (count < 0)
+    {
+        count = 0;
+    }
+
+    NetplayWrite32(p, NETPLAY_MAGIC);
+    NetplayWrite32(p + 4, netplay.remote_frame);
+    NetplayWrite32(p + 8, start);
+    p[12] = (Uint8)(Sint8)SDL_clamp(netplay.frame - netplay.remote_head, -128, 127);
+    p[13] = count;
+    for (int i = 0; i < count; i++)
+    {
+        Uint16 input = netplay.local[(start + i) % NETPLAY_INPUT_RING];
+        p[14 + i * 2] = input;
+        p[15 + i * 2] = input >> 8;
+    }
+
+    int newest = 0;
+    for (int i = 1; i < NETPLAY_CHECKSUM_RING; i++)
+    {
+        if (netplay.checksums[i].frame > netplay.checksums[newest].frame)
+        {
+            newest = i;
+        }
+    }
+    NetplayWrite32(p + 14 + count * 2, netplay.checksums[newest].frame);
+    NetplayWrite32(p + 18 + count * 2, netplay.checksums[newest].hash);
+
+    NetplayQueuePacket(p, 14 + count * 2 + 8);
+    netplay.last_send_ns = SDL_GetTicksNS();
+}
+
+static void NetplayQueuePacket(const Uint8 *data, int size)
+{
+    if (netplay.options.loss > 0 && SDL_randf() < netplay.options.loss)
+    {
+        return;
+    }
+
+    if (!netplay.options.latency_ms)
+    {
+        sendto(
+            netplay.socket,
+            (const char *)data,
+            size,
+            0,
+            (struct sockaddr *)&netplay.remote,
+            sizeof(netplay.remote)
+        );
+        return;
+    }
+
+    for (int i = 0; i < NETPLAY_DELAY_QUEUE; i++)
+    {
+        NetplayPacket *packet = &netplay.queue[i];
+        if (!packet->size)
+        {
+            packet->due = SDL_GetTicksNS() + SDL_MS_TO_NS(netplay.options.latency_ms);
+            packet->size = size;
+            SDL_memcpy(packet->data, data, size);
+            return;
+        }
+    }
+}
+
+static void NetplayFlushQueue()
+{
+    Uint64 now = SDL_GetTicksNS();
+    for (int i = 0; i < NETPLAY_DELAY_QUEUE; i++)
+    {
+        NetplayPacket *packet = &netplay.queue[i];
+        if (packet->size && packet->due <= now)
+        {
+            sendto(
+                netplay.socket,
+                (const char *)packet->data,
+                packet->size,
+                0,
+                (struct sockaddr *)&netplay.remote,
+                sizeof(netplay.remote)
+            );
+            packet->size = 0;
+        }
+    }
+}
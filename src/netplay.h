@@ -0,0 +1,24 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+
+#define NETPLAY_MAX_ROLLBACK 8
+
+typedef struct {
+    const char *host;
+    Uint16 local_port;
+    Uint16 remote_port;
+    unsigned player;
+    unsigned latency_ms;
+    float loss;
+} NetplayOptions;
+
+bool Netplay_Init(NetplayOptions options);
+void Netplay_Free();
+
+bool Netplay_IsActive();
+bool Netplay_RunFrame();
+
+// Does the work of a live frame that mispredicted the last `frames` frames: rolls back, re-simulates,
+// saves and steps the live frame and checksums a state. Doesn't advance the session; for benchmarks.
+void Netplay_Rollback(int frames);
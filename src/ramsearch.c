@@ -0,0 +1,301 @@
+#include "ramsearch.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_intrin.h>
+#include <SDL3/SDL_assert.h>
+
+// Candidates are kept as one bit per aligned value, 64 values per word.
+static struct {
+    RamSearchWidth width;
+    size_t size;
+    size_t lanes;
+    size_t words;
+    Uint8 *previous;
+    Uint64 *candidates;
+    size_t count;
+} search;
+
+static int RamSearchPopCount(Uint64 v)
+{
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((v * 0x0101010101010101ull) >> 56);
+}
+
+static Uint32 RamSearchLoad(const Uint8 *p, RamSearchWidth width)
+{
+    switch (width)
+    {
+    case RAMSEARCH_8: return p[0];
+    case RAMSEARCH_16: return p[0] | (p[1] << 8);
+    default: return p[0] | (p[1] << 8) | (p[2] << 16) | ((Uint32)p[3] << 24);
+    }
+}
+
+static bool RamSearchTest(Uint32 value, Uint32 previous, RamSearchFilter filter, Sint64 a, Sint64 b)
+{
+    int shift = 64 - search.width * 8;
+    switch (filter)
+    {
+    case RAMSEARCH_EQUAL: return value == (Uint32)((Uint64)a << shift >> shift);
+    case RAMSEARCH_CHANGED: return value != previous;
+    case RAMSEARCH_UNCHANGED: return value == previous;
+    case RAMSEARCH_INCREASED: return value > previous;
+    case RAMSEARCH_DECREASED: return value < previous;
+    case RAMSEARCH_DELTA:
+        {
+            Sint64 delta = (Sint64)((Uint64)(value - previous) << shift) >> shift;
+            return delta >= a && delta <= b;
+        }
+    }
+    return false;
+}
+
+static Uint64 RamSearchScalarWord(
+    const Uint8 *memory,
+    size_t word,
+    RamSearchFilter filter,
+    Sint64 a,
+    Sint64 b
+)
+{
+    Uint64 mask = 0;
+    size_t lanes = SDL_min(search.lanes - word * 64, 64);
+    for (size_t i = 0; i < lanes; i++)
+    {
+        size_t offset = (word * 64 + i) * search.width;
+        Uint32 value = RamSearchLoad(memory + offset, search.width);
+        Uint32 previous = RamSearchLoad(search.previous + offset, search.width);
+        mask |= (Uint64)RamSearchTest(value, previous, filter, a, b) << i;
+    }
+    return mask;
+}
+
+#ifdef SDL_SSE2_INTRINSICS
+// Called with a constant width so that every switch folds away after inlining.
+SDL_FORCE_INLINE __m128i RamSearchSet1(Sint64 v, RamSearchWidth width)
+{
+    switch (width)
+    {
+    case RAMSEARCH_8: return _mm_set1_epi8((char)v);
+    case RAMSEARCH_16: return _mm_set1_epi16((short)v);
+    default: return _mm_set1_epi32((int)v);
+    }
+}
+
+SDL_FORCE_INLINE __m128i RamSearchCmpEq(__m128i x, __m128i y, RamSearchWidth width)
+{
+    switch (width)
+    {
+    case RAMSEARCH_8: return _mm_cmpeq_epi8(x, y);
+    case RAMSEARCH_16: return _mm_cmpeq_epi16(x, y);
+    default: return _mm_cmpeq_epi32(x, y);
+    }
+}
+
+SDL_FORCE_INLINE __m128i RamSearchCmpGt(__m128i x, __m128i y, RamSearchWidth width)
+{
+    switch (width)
+    {
+    case RAMSEARCH_8: return _mm_cmpgt_epi8(x, y);
+    case RAMSEARCH_16: return _mm_cmpgt_epi16(x, y);
+    default: return _mm_cmpgt_epi32(x, y);
+    }
+}
+
+SDL_FORCE_INLINE __m128i RamSearchSub(__m128i x, __m128i y, RamSearchWidth width)
+{
+    switch (width)
+    {
+    case RAMSEARCH_8: return _mm_sub_epi8(x, y);
+    case RAMSEARCH_16: return _mm_sub_epi16(x, y);
+    default: return _mm_sub_epi32(x, y);
+    }
+}
+
+SDL_FORCE_INLINE Uint64 RamSearchMoveMask(__m128i m, RamSearchWidth width)
+{
+    switch (width)
+    {
+    case RAMSEARCH_8: return (Uint16)_mm_movemask_epi8(m);
+    case RAMSEARCH_16: return (Uint8)_mm_movemask_epi8(_mm_packs_epi16(m, _mm_setzero_si128()));
+    default: return _mm_movemask_ps(_mm_castsi128_ps(m));
+    }
+}
+
+SDL_FORCE_INLINE size_t RamSearchSimd(
+    const Uint8 *memory,
+    RamSearchFilter filter,
+    Sint64 a,
+    Sint64 b,
+    RamSearchWidth width
+)
+{
+    // SSE2 only has signed compares, so unsigned ones flip the sign bit first.
+    const __m128i bias = RamSearchSet1((Sint64)1 << (width * 8 - 1), width);
+    const __m128i va = RamSearchSet1(a, width);
+    const __m128i vb = RamSearchSet1(b, width);
+    const int lanes_per_chunk = 16 / width;
+    const size_t full_words = search.size / (64 * width);
+
+    size_t count = 0;
+    for (size_t w = 0; w < full_words; w++)
+    {
+        Uint64 candidates = search.candidates[w];
+        if (!candidates)
+        {
+            continue;
+        }
+
+        const Uint8 *cur = memory + w * 64 * width;
+        Uint8 *prev = search.previous + w * 64 * width;
+        Uint64 mask = 0;
+        for (int k = 0; k < 4 * width; k++)
+        {
+            __m128i c = _mm_loadu_si128((const __m128i *)(cur + k * 16));
+            __m128i p = _mm_loadu_si128((const __m128i *)(prev + k * 16));
+            __m128i m;
+            switch (filter)
+            {
+            case RAMSEARCH_EQUAL:
+                m = RamSearchCmpEq(c, va, width);
+                break;
+            case RAMSEARCH_CHANGED:
+                m = _mm_xor_si128(RamSearchCmpEq(c, p, width), _mm_set1_epi32(-1));
+                break;
+            case RAMSEARCH_UNCHANGED:
+                m = RamSearchCmpEq(c, p, width);
+                break;
+            case RAMSEARCH_INCREASED:
+                m = RamSearchCmpGt(_mm_xor_si128(c, bias), _mm_xor_si128(p, bias), width);
+                break;
+            case RAMSEARCH_DECREASED:
+                m = RamSearchCmpGt(_mm_xor_si128(p, bias), _mm_xor_si128(c, bias), width);
+                break;
+            default:
+                {
+                    __m128i d = RamSearchSub(c, p, width);
+                    m = _mm_or_si128(RamSearchCmpGt(va, d, width), RamSearchCmpGt(d, vb, width));
+                    m = _mm_xor_si128(m, _mm_set1_epi32(-1));
+                }
+                break;
+            }
+            mask |= RamSearchMoveMask(m, width) << (k * lanes_per_chunk);
+        }
+
+        candidates &= mask;
+        search.candidates[w] = candidates;
+        if (candidates)
+        {
+            // Later passes only read values that are still candidates.
+            SDL_memcpy(prev, cur, 64 * width);
+            count += RamSearchPopCount(candidates);
+        }
+    }
+
+    for (size_t w = full_words; w < search.words; w++)
+    {
+        search.candidates[w] &= RamSearchScalarWord(memory, w, filter, a, b);
+        SDL_memcpy(search.previous + w * 64 * width, memory + w * 64 * width, search.size - w * 64 * width);
+        count += RamSearchPopCount(search.candidates[w]);
+    }
+    return count;
+}
+#endif
+
+bool RamSearch_Begin(const void *memory, size_t size, RamSearchWidth width)
+{
+    RamSearch_End();
+
+    SDL_assert(width == RAMSEARCH_8 || width == RAMSEARCH_16 || width == RAMSEARCH_32);
+    search.width = width;
+    search.size = size;
+    search.lanes = size / width;
+    search.words = (search.lanes + 63) / 64;
+    search.previous = SDL_malloc(size);
+    search.candidates = SDL_malloc(search.words * sizeof(Uint64));
+    if (!search.previous || !search.candidates)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to allocate RAM search buffers");
+        RamSearch_End();
+        return false;
+    }
+
+    SDL_memcpy(search.previous, memory, size);
+    SDL_memset(search.candidates, 0xFF, search.words * sizeof(Uint64));
+    if (search.lanes % 64)
+    {
+        search.candidates[search.words - 1] = ((Uint64)1 << (search.lanes % 64)) - 1;
+    }
+    search.count = search.lanes;
+    return true;
+}
+
+void RamSearch_End()
+{
+    SDL_free(search.previous);
+    SDL_free(search.candidates);
+    SDL_memset(&search, 0, sizeof(search));
+}
+
+size_t RamSearch_Filter(const void *memory, RamSearchFilter filter, Sint64 a, Sint64 b)
+{
+    SDL_assert(search.candidates);
+
+    if (filter == RAMSEARCH_DELTA)
+    {
+        Sint64 min = -((Sint64)1 << (search.width * 8 - 1));
+        Sint64 max = ((Sint64)1 << (search.width * 8 - 1)) - 1;
+        a = SDL_clamp(a, min, max);
+        b = SDL_clamp(b, min, max);
+        if (a > b)
+        {
+            SDL_memset(search.candidates, 0, search.words * sizeof(Uint64));
+            search.count = 0;
+            return 0;
+        }
+    }
+
+#ifdef SDL_SSE2_INTRINSICS
+    switch (search.width)
+    {
+    case RAMSEARCH_8: search.count = RamSearchSimd(memory, filter, a, b, RAMSEARCH_8); break;
+    case RAMSEARCH_16: search.count = RamSearchSimd(memory, filter, a, b, RAMSEARCH_16); break;
+    case RAMSEARCH_32: search.count = RamSearchSimd(memory, filter, a, b, RAMSEARCH_32); break;
+    }
+#else
+    search.count = 0;
+    for (size_t w = 0; w < search.words; w++)
+    {
+        if (!search.candidates[w])
+        {
+            continue;
+        }
+        search.candidates[w] &= RamSearchScalarWord(memory, w, filter, a, b);
+        search.count += RamSearchPopCount(search.candidates[w]);
+    }
+    SDL_memcpy(search.previous, memory, search.size);
+#endif
+
+    return search.count;
+}
+
+size_t RamSearch_GetCount()
+{
+    return search.count;
+}
+
+size_t RamSearch_GetResults(Uint32 *addresses, size_t max)
+{
+    size_t n = 0;
+    for (size_t w = 0; w < search.words && n < max; w++)
+    {
+        for (Uint64 bits = search.candidates[w]; bits && n < max; bits &= bits - 1)
+        {
+            int bit = RamSearchPopCount((bits & (~bits + 1)) - 1);
+            addresses[n++] = (Uint32)((w * 64 + bit) * search.width);
+        }
+    }
+    return n;
+}
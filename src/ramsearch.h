@@ -0,0 +1,25 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+
+typedef enum {
+    RAMSEARCH_8 = 1,
+    RAMSEARCH_16 = 2,
+    RAMSEARCH_32 = 4,
+} RamSearchWidth;
+
+typedef enum {
+    RAMSEARCH_EQUAL,     // value == a
+    RAMSEARCH_CHANGED,
+    RAMSEARCH_UNCHANGED,
+    RAMSEARCH_INCREASED, // unsigned
+    RAMSEARCH_DECREASED, // unsigned
+    RAMSEARCH_DELTA,     // a <= value - previous <= b, signed
+} RamSearchFilter;
+
+bool RamSearch_Begin(const void *memory, size_t size, RamSearchWidth width);
+void RamSearch_End();
+
+size_t RamSearch_Filter(const void *memory, RamSearchFilter filter, Sint64 a, Sint64 b);
+size_t RamSearch_GetCount();
+size_t RamSearch_GetResults(Uint32 *addresses, size_t max);
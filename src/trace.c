@@ -0,0 +1,123 @@
+#include "trace.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_assert.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_iostream.h>
+
+#define TRACE_MAX_THREADS 32
+#define TRACE_BUFFER_EVENTS 65536
+
+typedef struct {
+    const char *name;
+    Uint64 start;
+    Uint64 end;
+} TraceEvent;
+
+// Written only by its own thread. The count is published after the event so the dump never
+// reads a half-written entry, unless the ring has wrapped over it in the meantime.
+typedef struct {
+    SDL_ThreadID thread;
+    SDL_AtomicU32 count;
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+static struct {
+    SDL_TLSID tls;
+    SDL_AtomicInt threads;
+    TraceBuffer *buffers[TRACE_MAX_THREADS];
+} trace;
+
+static TraceBuffer *TraceGetBuffer()
+{
+    TraceBuffer *buffer = SDL_GetTLS(&trace.tls);
+    if (buffer)
+    {
+        return buffer;
+    }
+
+    int slot = SDL_AddAtomicInt(&trace.threads, 1);
+    if (slot >= TRACE_MAX_THREADS)
+    {
+        return 0;
+    }
+
+    buffer = SDL_calloc(1, sizeof(*buffer));
+    SDL_assert_release(buffer);
+    buffer->thread = SDL_GetCurrentThreadID();
+    SDL_SetTLS(&trace.tls, buffer, 0);
+    SDL_SetAtomicPointer((void **)&trace.buffers[slot], buffer);
+    return buffer;
+}
+
+void Trace_Record(const char *name, Uint64 start)
+{
+    Uint64 end = SDL_GetTicksNS();
+    TraceBuffer *buffer = TraceGetBuffer();
+    if (!buffer)
+    {
+        return;
+    }
+
+    Uint32 count = SDL_GetAtomicU32(&buffer->count);
+    buffer->events[count % TRACE_BUFFER_EVENTS] = (TraceEvent){ name, start, end };
+    SDL_SetAtomicU32(&buffer->count, count + 1);
+}
+
+bool Trace_Dump(const char *path)
+{
+    SDL_IOStream *io = SDL_IOFromFile(path, "w");
+    if (!io)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to open \"%s\": %s", path, SDL_GetError());
+        return false;
+    }
+
+    size_t total = 0;
+    SDL_IOprintf(io, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int i = 0; i < TRACE_MAX_THREADS; i++)
+    {
+        TraceBuffer *buffer = SDL_GetAtomicPointer((void **)&trace.buffers[i]);
+        if (!buffer)
+        {
+            continue;
+        }
+
+        Uint64 tid = buffer->thread;
+        SDL_IOprintf(
+            io,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%" SDL_PRIu64 ",\"args\":{\"name\":\"thread %d\"}}",
+            total ? ",\n" : "",
+            tid,
+            i
+        );
+        total++;
+
+        Uint32 count = SDL_GetAtomicU32(&buffer->count);
+        Uint32 first = count - SDL_min(count, TRACE_BUFFER_EVENTS);
+        for (Uint32 e = first; e != count; e++)
+        {
+            const TraceEvent *event = &buffer->events[e % TRACE_BUFFER_EVENTS];
+            SDL_IOprintf(
+                io,
+                ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%" SDL_PRIu64 ",\"ts\":%.3f,\"dur\":%.3f}",
+                event->name,
+                tid,
+                event->start / 1000.0,
+                (event->end - event->start) / 1000.0
+            );
+            total++;
+        }
+    }
+    SDL_IOprintf(io, "\n]}\n");
+
+    if (!SDL_CloseIO(io))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "failed to write \"%s\": %s", path, SDL_GetError());
+        return false;
+    }
+
+    SDL_Log("Wrote %zu trace events to \"%s\"", total, path);
+    return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <SDL3/SDL_timer.h>
+#include <SDL3/SDL_stdinc.h>
+
+#ifdef EMULATOR_TRACE
+#define TRACE_BEGIN(zone) Uint64 trace_##zone = SDL_GetTicksNS()
+#define TRACE_END(zone) Trace_Record(#zone, trace_##zone)
+#else
+#define TRACE_BEGIN(zone)
+#define TRACE_END(zone)
+#endif
+
+void Trace_Record(const char *name, Uint64 start);
+bool Trace_Dump(const char *path);